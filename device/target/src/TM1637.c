@@ -5,157 +5,254 @@
  * @brief Implementation for the TM1637 6 digit display module driver
  */
 
-// TODO: Invert byte order and make it work for common cathode.
+// TODO: Make it work for common cathode.
 
 #include <stdint.h>
 #include <stdbool.h>
 
-#include <stdio.h>
+#include <util/delay.h>
 
 #include "avr_extends/GPIO.h"
-#include "avr_extends/delay.h"
+#include "avr_extends/uptime.h"
+
+#include "display_device.h"
 
 #include "TM1637.h"
 
-#define BIT_TIME_US 1000 // Time taken for one bit
+// Time taken for one bit, the datasheet allows a clock of up to 250kHz but
+// the open drain lines need time to rise through the module pull ups
+#ifndef TM1637_BIT_TIME_US
+#define TM1637_BIT_TIME_US 10
+#endif
+#define INIT_DELAY_MS 500 // Time between display on and the data command
 
-#define SET_WRITE_FIX_ADDR_CMD 0b01000000 // Put the device into write data with fixed address mode
+#define DATA_CMD_AUTO_ADDR 0b01000000 // Write data with an auto incrementing address
 #define DISPLAY_ON_10_16 0b10001101 // Turn the display on and use 10/16 pulse widths
 #define DISPLAY_OFF_1_16 0b10000000
+#define CONTROL_BYTE 0b10000000
+#define DISP_ON_BYTE 0b00001000
+#define BRIGHTNESS_MASK 0b00000111
 
-// Digit registers
-#define C0H 0b11000000
-#define C1H 0b11000001
-#define C2H 0b11000010
-#define C3H 0b11000011
-#define C4H 0b11000100
-#define C5H 0b11000101
+#define ADDR_CMD_C0H 0b11000000 // Address of the first digit register
 
-static void send_start(struct TM1637Device device) {
-    GPIO_pin_init(device.dataPin, INPUT_NO_PULLUP);
-    GPIO_pin_init(device.clockPin, INPUT_NO_PULLUP);
-    delay_us(BIT_TIME_US/2);
+static void send_start(const struct TM1637Device* device) {
+    GPIO_pin_init(device->dataPin, INPUT_NO_PULLUP);
+    GPIO_pin_init(device->clockPin, INPUT_NO_PULLUP);
+    _delay_us(TM1637_BIT_TIME_US / 2.0);
 
-    GPIO_set_output(device.dataPin, false);
-    GPIO_pin_init(device.dataPin, OUTPUT);
+    GPIO_set_output(device->dataPin, false);
+    GPIO_pin_init(device->dataPin, OUTPUT);
 
-    delay_us(BIT_TIME_US/2);
-    GPIO_set_output(device.clockPin, false);
-    GPIO_pin_init(device.clockPin, OUTPUT);
+    _delay_us(TM1637_BIT_TIME_US / 2.0);
+    GPIO_set_output(device->clockPin, false);
+    GPIO_pin_init(device->clockPin, OUTPUT);
 }
 
-static void send_byte(struct TM1637Device device, uint8_t byte) {  
-    GPIO_pin_init(device.dataPin, OUTPUT);
-    GPIO_pin_init(device.clockPin, OUTPUT);
-    GPIO_set_output(device.clockPin, false);
-  
+/** 
+ * @brief Send a byte LSB first and read the ack that follows it
+ * @param device the device to send to
+ * @param byte the byte to send
+ * 
+ * @return 0 if the device acknowledged the byte
+ */
+static uint8_t send_byte(const struct TM1637Device* device, uint8_t byte) {  
     for (uint8_t i = 0; i < 8; i++) {
-        delay_us(BIT_TIME_US/4);
-        GPIO_set_output(device.dataPin, byte & (1 << (7-i)));
-        delay_us(BIT_TIME_US/4);
-        GPIO_set_output(device.clockPin, true);
-        delay_us(BIT_TIME_US/2);
-        GPIO_set_output(device.clockPin, false);
+        GPIO_set_output(device->dataPin, byte & (1 << i));
+        _delay_us(TM1637_BIT_TIME_US / 2.0);
+        GPIO_set_output(device->clockPin, true);
+        _delay_us(TM1637_BIT_TIME_US / 2.0);
+        GPIO_set_output(device->clockPin, false);
     }
-}
 
-static void send_stop(struct TM1637Device device) {
-    GPIO_set_output(device.clockPin, false);
-    GPIO_set_output(device.dataPin, false);
-    delay_us(BIT_TIME_US/2);
+    // The device pulls data low during the ninth clock to ack
+    GPIO_pin_init(device->dataPin, INPUT_NO_PULLUP);
+    _delay_us(TM1637_BIT_TIME_US / 2.0);
+    GPIO_set_output(device->clockPin, true);
+    _delay_us(TM1637_BIT_TIME_US / 4.0);
+    uint8_t nack = GPIO_get_state(device->dataPin) ? 1 : 0;
+    _delay_us(TM1637_BIT_TIME_US / 4.0);
+    GPIO_set_output(device->clockPin, false);
+    GPIO_set_output(device->dataPin, false);
+    GPIO_pin_init(device->dataPin, OUTPUT);
 
-    GPIO_pin_init(device.clockPin, INPUT_NO_PULLUP);
-    delay_us(BIT_TIME_US/2);
-    GPIO_pin_init(device.dataPin, INPUT_NO_PULLUP);
+    return nack;
 }
 
-static int get_ack(struct TM1637Device device) {
-    int result = 0;
-    GPIO_set_output(device.dataPin, false);
-    GPIO_pin_init(device.dataPin, INPUT_NO_PULLUP);
-    delay_us(BIT_TIME_US/2);
-    GPIO_set_output(device.clockPin, true);
-    delay_us(BIT_TIME_US/4);
-    result = GPIO_get_state(device.dataPin);
-    delay_us(BIT_TIME_US/4);
-    GPIO_set_output(device.clockPin, false);
-    GPIO_set_output(device.dataPin, false);
-    GPIO_pin_init(device.dataPin, OUTPUT);
+static void send_stop(const struct TM1637Device* device) {
+    GPIO_set_output(device->clockPin, false);
+    GPIO_set_output(device->dataPin, false);
+    _delay_us(TM1637_BIT_TIME_US / 2.0);
 
-    return result;
+    GPIO_pin_init(device->clockPin, INPUT_NO_PULLUP);
+    _delay_us(TM1637_BIT_TIME_US / 2.0);
+    GPIO_pin_init(device->dataPin, INPUT_NO_PULLUP);
 }
 
-int tm1637_init(struct TM1637Device device) {
-    GPIO_pin_init(device.dataPin, INPUT_NO_PULLUP);
-    GPIO_pin_init(device.clockPin, INPUT_NO_PULLUP);
-    
-    int result = 0;
+/** 
+ * @brief Send a single byte command in its own transaction
+ * @param device the device to send to
+ * @param command the command byte
+ * 
+ * @return 0 if the device acknowledged the command
+ */
+static uint8_t send_command(const struct TM1637Device* device, uint8_t command) {
     send_start(device);
-    send_byte(device, DISPLAY_ON_10_16);
-    result = get_ack(device);
+    uint8_t nack = send_byte(device, command);
     send_stop(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display on setting error = 0x%x\n", result);
-    }
-    delay_ms(500);
 
-    send_start(device);
-    send_byte(device, SET_WRITE_FIX_ADDR_CMD);
-    result = get_ack(device);
-    send_stop(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in data command setting error = 0x%x\n", result);
-    }
+    return nack;
+}
+
+int tm1637_init(struct TM1637Device* device) {
+    GPIO_pin_init(device->dataPin, INPUT_NO_PULLUP);
+    GPIO_pin_init(device->clockPin, INPUT_NO_PULLUP);
+
+    device->_initState = TM1637_INIT_START;
+    device->_ackErrors = 0;
+    device->_control = DISPLAY_ON_10_16;
 
     return 0;
 }
 
-int tm1637_write(struct TM1637Device device, uint32_t value) {
-    printf("Attempting to write to \"%s\" value: 0x%lx\n", device.name, value);
+bool tm1637_init_update(struct TM1637Device* device) {
+    uint32_t now = uptime_ms();
 
-    int result = 0;
+    switch (device->_initState) {
+    case TM1637_INIT_START:
+        if (send_command(device, device->_control)) {
+            device->_ackErrors |= TM1637_ACK_CONTROL;
+        }
+        device->_initTime = now;
+        device->_initState = TM1637_INIT_DATA_COMMAND;
+        break;
 
+    case TM1637_INIT_DATA_COMMAND:
+        if (now - device->_initTime < INIT_DELAY_MS) {
+            break;
+        }
 
-    send_start(device);
-    send_byte(device, C0H);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in register select = 0x%x\n", result);
+        if (send_command(device, DATA_CMD_AUTO_ADDR)) {
+            device->_ackErrors |= TM1637_ACK_DATA_COMMAND;
+        }
+        device->_initState = TM1637_INIT_READY;
+        break;
+
+    case TM1637_INIT_READY:
+        return true;
     }
-    send_byte(device, 0b00111101);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+
+    return false;
+}
+
+int tm1637_write_segments(struct TM1637Device* device, const uint8_t segments[TM1637_DIGITS]) {
+    // The data command is repeated so the write does not depend on the
+    // start up having been acknowledged
+    uint16_t errors = send_command(device, DATA_CMD_AUTO_ADDR) ? TM1637_ACK_DATA_COMMAND : 0;
+
+    send_start(device);
+    if (send_byte(device, ADDR_CMD_C0H)) {
+        errors |= TM1637_ACK_ADDRESS;
     }
-    send_byte(device, 0b00000000);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+    for (uint8_t i = 0; i < TM1637_DIGITS; i++) {
+        if (send_byte(device, segments[i])) {
+            errors |= TM1637_ACK_DIGIT(i);
+        }
     }
-    send_byte(device, 0b11111111);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+    send_stop(device);
+
+    device->_ackErrors |= errors;
+
+    return (errors == 0) ? 0 : 1;
+}
+
+int tm1637_write(struct TM1637Device* device, uint32_t value) {
+    uint8_t segments[TM1637_DIGITS];
+
+    for (uint8_t i = TM1637_DIGITS; i > 0; i--) {
+        segments[i - 1] = HexTo7Seg[value & 0xF];
+        value >>= 4;
     }
-    send_byte(device, 0b11111111);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+
+    return tm1637_write_segments(device, segments);
+}
+
+/** 
+ * @brief Send a new display control command if it changes the display
+ * @param device the device to control
+ * @param control the control command
+ * 
+ * @return 0 if successful, 1 if the command was not acknowledged
+ */
+static int set_control(struct TM1637Device* device, uint8_t control) {
+    if (control == device->_control) {
+        return 0;
     }
-    send_byte(device, 0b11111111);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+    device->_control = control;
+
+    // The start up sends the latest control command
+    if (device->_initState == TM1637_INIT_START) {
+        return 0;
     }
-    send_byte(device, 0b11111111);
-    result = get_ack(device);
-    if (result != 0) {
-        printf("ERROR: Bad ack in display write = 0x%x\n", result);
+
+    if (send_command(device, control)) {
+        device->_ackErrors |= TM1637_ACK_CONTROL;
+        return 1;
     }
-    send_stop(device);
 
+    return 0;
+}
+
+int tm1637_set_display_state(struct TM1637Device* device, bool state) {
+    uint8_t brightness = device->_control & BRIGHTNESS_MASK;
 
-    printf("Completed write ack result = 0x%x\n", result);
+    return set_control(device, CONTROL_BYTE | (state ? DISP_ON_BYTE : 0) | brightness);
+}
 
-    return 0;
-}
\ No newline at end of file
+int tm1637_set_brightness(struct TM1637Device* device, uint8_t brightness) {
+    uint8_t state = device->_control & DISP_ON_BYTE;
+
+    return set_control(device, CONTROL_BYTE | state | (brightness & BRIGHTNESS_MASK));
+}
+
+uint16_t tm1637_take_ack_errors(struct TM1637Device* device) {
+    uint16_t errors = device->_ackErrors;
+    device->_ackErrors = 0;
+
+    return errors;
+}
+
+// Display interface backend, each device has its own pins so writes are sent
+// straight away and there is nothing to flush
+static bool backend_init_update(void* backend) {
+    return tm1637_init_update(backend);
+}
+
+static int backend_write(void* backend, const uint8_t segments[], uint8_t start, uint8_t len) {
+    (void)start;
+    (void)len;
+
+    // Every digit is sent in one auto incrementing transaction, the display
+    // interface only calls this when a digit changed or the last write failed
+    return tm1637_write_segments(backend, segments);
+}
+
+static void backend_flush(void* backends[], uint8_t numBackends) {
+    (void)backends;
+    (void)numBackends;
+}
+
+static void backend_set_brightness(void* backend, uint8_t brightness) {
+    tm1637_set_brightness(backend, brightness);
+}
+
+static void backend_set_power(void* backend, bool on) {
+    tm1637_set_display_state(backend, on);
+}
+
+const struct DisplayDeviceOps tm1637DisplayOps = {
+    .init_update = backend_init_update,
+    .write = backend_write,
+    .flush = backend_flush,
+    .set_brightness = backend_set_brightness,
+    .set_power = backend_set_power,
+};
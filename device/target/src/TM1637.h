@@ -15,28 +15,100 @@
 
 #include "avr_extends/GPIO.h"   
 
+#include "display_device.h"
+
+#define TM1637_DIGITS 6 // Digits written by each transaction
+
+// Ack error bits, one for each byte the driver sends
+#define TM1637_ACK_CONTROL (1 << 0) // Display on, off or brightness command
+#define TM1637_ACK_DATA_COMMAND (1 << 1) // Auto incrementing data command
+#define TM1637_ACK_ADDRESS (1 << 2) // Address of the first digit
+#define TM1637_ACK_DIGIT(digit) (1 << (3 + (digit))) // Segments of a digit, 0 is the left
+
+/// @brief The steps of the non blocking start up
+typedef enum TM1637InitState_e {
+    TM1637_INIT_START,
+    TM1637_INIT_DATA_COMMAND,
+    TM1637_INIT_READY,
+} TM1637InitState_t;
+
 struct TM1637Device {
     pin_t dataPin; // The data signal pin
     pin_t clockPin; // The clock signal pin
     char* name;
+
+    // Private
+    TM1637InitState_t _initState; // Progress of the start up
+    uint32_t _initTime; // Time of the last start up step in ms
+    uint16_t _ackErrors; // TM1637_ACK bits of the bytes not acknowledged since last taken
+    uint8_t _control; // The display control command last sent
 };
 
+// The display interface backend, the backend pointer is a struct TM1637Device
+extern const struct DisplayDeviceOps tm1637DisplayOps;
+
 /** 
- * @brief Initialise a new driver
+ * @brief Initialise a new driver, this does not block and the device is
+ * brought up by calling tm1637_init_update
  * @param device The device struct to initialise
  * 
  * @return 0 if successful
  */
-int tm1637_init(struct TM1637Device device);
+int tm1637_init(struct TM1637Device* device);
+
+/** 
+ * @brief Advance the start up of a device, this must be called regularly
+ * until it returns true
+ * @param device the device to bring up
+ * 
+ * @return true once the device is ready to be written to
+ */
+bool tm1637_init_update(struct TM1637Device* device);
+
+/** 
+ * @brief Write segments to every digit in one auto incrementing transaction
+ * @param device the device struct to write to
+ * @param segments the segments for each digit starting at the left
+ * 
+ * @return 0 if successful, 1 if a byte was not acknowledged
+ */
+int tm1637_write_segments(struct TM1637Device* device, const uint8_t segments[TM1637_DIGITS]);
 
 /** 
  * @brief Write to the display a value
  * @param device the device struct to write to
  * @param value the value to write where each hex digit is the displayed value
  * 
- * @return 0 if successful
+ * @return 0 if successful, 1 if a byte was not acknowledged
+ */
+int tm1637_write(struct TM1637Device* device, uint32_t value);
+
+/** 
+ * @brief Turn the display on or off
+ * @param device the device to control
+ * @param state true to turn on the display
+ * 
+ * @return 0 if successful, 1 if the command was not acknowledged
+ */
+int tm1637_set_display_state(struct TM1637Device* device, bool state);
+
+/** 
+ * @brief Set the display brightness, a display that is off stays off
+ * @param device the device to control
+ * @param brightness the brightness to set 0-7
+ * 
+ * @return 0 if successful, 1 if the command was not acknowledged
+ */
+int tm1637_set_brightness(struct TM1637Device* device, uint8_t brightness);
+
+/** 
+ * @brief Get and clear the ack errors collected since they were last taken
+ * @param device the device to check
+ * 
+ * @return 0 if every byte was acknowledged, otherwise the TM1637_ACK bit of
+ * each byte that failed
  */
-int tm1637_write(struct TM1637Device device, uint32_t value);
+uint16_t tm1637_take_ack_errors(struct TM1637Device* device);
 
 
 
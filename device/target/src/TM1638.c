@@ -11,12 +11,92 @@
 
 #include <stdio.h>
 
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <util/delay.h>
+#include <util/delay_basic.h>
+
 #include "avr_extends/GPIO.h"
 #include "avr_extends/delay.h"
 
+#include "avr_extends/uptime.h"
+
+#include "pin.h"
+
+#include "display_device.h"
+
 #include "TM1638.h"
 
-#define BIT_TIME_US 1000 // Time taken for one bit
+#define BIT_TIME_US 1000 // Time taken for one bit using the GPIO transport
+
+#ifndef TM1638_FAST_TRANSPORT
+#define TM1638_FAST_TRANSPORT 1 // Clock bytes using direct writes to DISP_PORT
+#endif
+
+// Fast transport timing, the datasheet minimums are 400ns clock pulse width
+// (1MHz max), 1us from the last clock edge to stb high and 1us from the read
+// command to the first key scan bit. TM1638_CLK_HALF_US is used until the
+// device is calibrated.
+#ifndef TM1638_CLK_HALF_US
+#define TM1638_CLK_HALF_US 0.5
+#endif
+#ifndef TM1638_STB_US
+#define TM1638_STB_US 1
+#endif
+#define TM1638_WAIT_US 1
+
+// Calibration of the fast transport clock
+#ifndef TM1638_CALIBRATION_SLOW_US
+#define TM1638_CALIBRATION_SLOW_US 10 // Slowest half clock period tried
+#endif
+#define TM1638_CALIBRATION_READS 4 // Key scans that must match at each period
+#define TM1638_CALIBRATION_MARGIN 2 // Multiplier applied to the fastest period
+
+#define INIT_DELAY_MS 200 // Time between the start up display commands
+
+// The stb pins are listed at compile time by DISP_STB_PINS so selecting
+// each one compiles to a single sbi/cbi
+#define STB_PIN_BIT(pinNum) | (1 << (pinNum))
+#define STB_PINS_MASK (0 DISP_STB_PINS(STB_PIN_BIT))
+#define STB_PIN_LOW(pinNum) if (stbMask & (1 << (pinNum))) { DISP_PORT &= ~(1 << (pinNum)); }
+#define STB_PIN_HIGH(pinNum) if (stbMask & (1 << (pinNum))) { DISP_PORT |= (1 << (pinNum)); }
+
+#define CLK_DELAY_LOOPS(us) ((uint8_t)((us) * (F_CPU / 1000000UL) / 3 + 1)) // 3 cycles per _delay_loop_1 loop
+
+// The fast transport sends a whole byte each tick and the tick is timed from
+// the end of the byte. A byte at the calibrated clock keeps the interrupt busy
+// for about 40us, so a 60us gap leaves at most one transfer interrupt in each
+// 87us byte of the 115200 baud host UART.
+#if TM1638_FAST_TRANSPORT
+#define TRANSFER_TICK_US 60 // Idle time after each byte
+#define TRANSFER_TIMER_PRESCALER 8
+#define TRANSFER_TIMER_CS (1 << CS21)
+#else
+#define TRANSFER_TICK_US (BIT_TIME_US / 2) // One half bit is sent each tick
+#define TRANSFER_TIMER_PRESCALER 64
+#define TRANSFER_TIMER_CS (1 << CS22)
+#endif
+
+// The queue holds the largest frame so a commit is clocked out as one burst.
+// Each device adds at most a control command and 17 bytes of runs (a run
+// costs an address byte, runs are two or more unchanged bytes apart so
+// splitting never beats one run of all of RAM), and the frame shares the two
+// data commands. One slot is kept empty to tell a full queue from an empty
+// one.
+#ifndef TM1638_FRAME_DEVICES
+#define TM1638_FRAME_DEVICES 2 // Devices committed together in the largest frame
+#endif
+#define TRANSFER_DEVICE_BYTES (1 + 1 + TM1638_RAM_SIZE)
+#define TRANSFER_FRAME_BYTES (TM1638_FRAME_DEVICES * TRANSFER_DEVICE_BYTES + 2)
+#define TRANSFER_QUEUE_SIZE (TRANSFER_FRAME_BYTES + 1) // Number of bytes that can be waiting to send
+#define TRANSFER_TIMER_TOP ((F_CPU / TRANSFER_TIMER_PRESCALER) * TRANSFER_TICK_US / 1000000UL - 1)
+
+#define TRANSFER_START 0x01 // Pull the stb pin low before the byte
+#define TRANSFER_STOP 0x02 // Release the stb pin after the byte
+
+#define TRANSFER_STEP_BITS 1 // First step of the bits, two steps per bit
+#define TRANSFER_STEP_STOP (TRANSFER_STEP_BITS + 16)
 
 #define DISP_OFF_BYTE 0x00
 #define DISP_ON_BYTE 0x08
@@ -30,200 +110,872 @@
 #define NORMAL_MODE_BYTE 0x00
 #define TEST_MODE_BYTE 0x08
 #define FIXED_ADDRESS_BYTE 0x04
-
-// Digits
-const uint8_t HexTo7Seg[40] =
-{
-  0x3F, // 0
-  0x06, // 1
-  0x5B, // 2
-  0x4F, // 3
-  0x66, // 4
-  0x6D, // 5
-  0x7D, // 6
-  0x07, // 7
-  0x7F, // 8
-  0x6F, // 9
-  0x77, // A
-  0x7c, // b
-  0x39, // C
-  0x5E, // d
-  0x79, // E
-  0x71, // F
-  0x6F, // g
-  0x3D, // G
-  0x74, // h
-  0x76, // H
-  0x05, // i
-  0x06, // I
-  0x0D, // j
-  0x30, // l
-  0x38, // L
-  0x54, // n
-  0x37, // N
-  0x5C, // o
-  0x3F, // O
-  0x73, // P
-  0x67, // q
-  0x50, // r
-  0x6D, // S
-  0x78, // t
-  0x1C, // u
-  0x3E, // U
-  0x66, // y
-  0x08, // _
-  0x40, // -
-  0x01  // Overscore
+#define READ_KEY_BYTE 0x02
+
+#define KEY_SCAN_BYTES 4
+#define KEY_SCAN_RESERVED_BITS 0x88 // Always read as 0 in the key scan data
+#define UNKNOWN_ADDRESS_MODE 0xFF
+
+/// @brief A byte waiting to be clocked out by the transfer timer
+struct TM1638Transfer {
+#if TM1638_FAST_TRANSPORT
+    uint8_t stbMask; // The DISP_PORT bits of every stb pin to select
+    uint8_t clkDelay; // The half clock period in _delay_loop_1 loops
+#else
+    struct TM1638Device* device;
+#endif
+    uint8_t byte;
+    uint8_t flags;
 };
 
-static void send_start(struct TM1638Device device) {
-    GPIO_set_output(device.stbPin, false);
-    GPIO_pin_init(device.stbPin, OUTPUT);
+static volatile struct TM1638Transfer transferQueue[TRANSFER_QUEUE_SIZE];
+static volatile uint8_t transferHead = 0; // Next free slot, written by the main loop
+static volatile uint8_t transferTail = 0; // Byte being sent, written by the ISR
+static volatile uint8_t transferRelease = 0; // The ISR stops here, written by the main loop
+static bool transferHeld = false; // True while a frame is queued, transferRelease is moved once it is all queued
+#if !TM1638_FAST_TRANSPORT
+static uint8_t transferStep = 0; // Half bit step of the byte being sent
+#endif
+
+#if !TM1638_FAST_TRANSPORT
+static void send_start(const struct TM1638Device* device) {
+    GPIO_set_output(device->stbPin, false);
+    GPIO_pin_init(device->stbPin, OUTPUT);
 }
 
-static void send_byte(struct TM1638Device device, uint8_t byte) {
-    GPIO_pin_init(device.dataPin, OUTPUT);
-    GPIO_pin_init(device.clockPin, OUTPUT);
+static void send_stop(const struct TM1638Device* device) {
+    GPIO_set_output(device->stbPin, true);
+    GPIO_pin_init(device->stbPin, OUTPUT);
+}
+#endif
+
+#ifdef TM1638_BENCHMARK
+static void send_byte(const struct TM1638Device* device, uint8_t byte) {
+    GPIO_pin_init(device->dataPin, OUTPUT);
+    GPIO_pin_init(device->clockPin, OUTPUT);
 
     for (uint8_t i = 0; i < 8; i++) {
-        GPIO_set_output(device.clockPin, false);
+        GPIO_set_output(device->clockPin, false);
         delay_us(BIT_TIME_US / 2);
-        GPIO_set_output(device.dataPin, byte & (1 << (i)));
-        GPIO_set_output(device.clockPin, true);
+        GPIO_set_output(device->dataPin, byte & (1 << (i)));
+        GPIO_set_output(device->clockPin, true);
         delay_us(BIT_TIME_US / 2);
     }
 }
+#endif
 
-static void send_stop(struct TM1638Device device) {
-    GPIO_set_output(device.stbPin, true);
-    GPIO_pin_init(device.stbPin, OUTPUT);
+/** 
+ * @brief Pull stb pins low using the fast transport
+ * @param stbMask the DISP_PORT bits of the stb pins
+ * 
+ */
+static inline void fast_start(uint8_t stbMask) {
+    DISP_STB_PINS(STB_PIN_LOW)
 }
 
-int tm1638_init(struct TM1638Device* device, pin_t stbPin, pin_t dataPin, pin_t clockPin) {
-    device->stbPin = stbPin;
+/** 
+ * @brief Clock a byte out lsb first using the fast transport
+ * @param byte the byte to send
+ * @param clkDelay the half clock period in _delay_loop_1 loops
+ * 
+ */
+static inline void fast_byte(uint8_t byte, uint8_t clkDelay) {
+    for (uint8_t i = 0; i < 8; i++) {
+        DISP_PORT &= ~(1 << DISP_CLK_PIN_NUM);
+        if (byte & 1) {
+            DISP_PORT |= (1 << DISP_DATA_PIN_NUM);
+        } else {
+            DISP_PORT &= ~(1 << DISP_DATA_PIN_NUM);
+        }
+        _delay_loop_1(clkDelay);
+        DISP_PORT |= (1 << DISP_CLK_PIN_NUM);
+        _delay_loop_1(clkDelay);
+        byte >>= 1;
+    }
+}
+
+/** 
+ * @brief Release stb pins using the fast transport
+ * @param stbMask the DISP_PORT bits of the stb pins
+ * 
+ */
+static inline void fast_stop(uint8_t stbMask) {
+    _delay_us(TM1638_STB_US);
+    DISP_STB_PINS(STB_PIN_HIGH)
+}
+
+/** 
+ * @brief Advance the transfer at the tail of the queue by one byte for the
+ * fast transport or one half bit for the GPIO transport. The timer is
+ * stopped once the queue is empty.
+ * 
+ */
+static void transfer_step(void) {
+    if (transferTail == transferRelease) {
+        TIMSK2 &= ~(1 << OCIE2A);
+        return;
+    }
+
+    volatile struct TM1638Transfer* transfer = &transferQueue[transferTail];
+
+#if TM1638_FAST_TRANSPORT
+    if (transfer->flags & TRANSFER_START) {
+        fast_start(transfer->stbMask);
+    }
+    fast_byte(transfer->byte, transfer->clkDelay);
+    if (transfer->flags & TRANSFER_STOP) {
+        fast_stop(transfer->stbMask);
+    }
+
+    // Start the gap to the next byte now, a byte at the slowest clock takes
+    // longer than a tick and would otherwise be followed straight away
+    TCNT2 = 0;
+    TIFR2 = (1 << OCF2A);
+#else
+    if (transferStep == 0) {
+        GPIO_pin_init(transfer->device->dataPin, OUTPUT);
+        GPIO_pin_init(transfer->device->clockPin, OUTPUT);
+        transferStep = TRANSFER_STEP_BITS;
+
+        if (transfer->flags & TRANSFER_START) {
+            send_start(transfer->device);
+            return;
+        }
+    }
+
+    if (transferStep < TRANSFER_STEP_STOP) {
+        uint8_t bit = (transferStep - TRANSFER_STEP_BITS) / 2;
+
+        if (((transferStep - TRANSFER_STEP_BITS) & 1) == 0) {
+            GPIO_set_output(transfer->device->clockPin, false);
+            GPIO_set_output(transfer->device->dataPin, transfer->byte & (1 << bit));
+        } else {
+            GPIO_set_output(transfer->device->clockPin, true);
+        }
+        transferStep++;
+        return;
+    }
+
+    if (transfer->flags & TRANSFER_STOP) {
+        send_stop(transfer->device);
+    }
+
+    transferStep = 0;
+#endif
+    transferTail = (transferTail + 1 == TRANSFER_QUEUE_SIZE) ? 0 : transferTail + 1;
+}
+
+ISR(TIMER2_COMPA_vect) {
+    transfer_step();
+}
+
+/** 
+ * @brief Setup timer 2 to tick every TRANSFER_TICK_US
+ * 
+ */
+static void transfer_init(void) {
+    TCCR2A = (1 << WGM21); // CTC mode
+    TCCR2B = TRANSFER_TIMER_CS;
+    OCR2A = TRANSFER_TIMER_TOP;
+}
+
+/** 
+ * @brief Let the transfer timer clock out everything queued so far
+ * 
+ */
+static void release_queued(void) {
+    transferRelease = transferHead;
+
+    if (transferHead != transferTail) {
+        TIMSK2 |= (1 << OCIE2A);
+    }
+}
+
+/** 
+ * @brief Add a transfer to the queue and start the transfer timer unless
+ * transfers are held. If the queue is full this waits for the released
+ * transfers to be sent.
+ * @param transfer the transfer to add
+ * 
+ */
+static void queue_transfer(struct TM1638Transfer transfer) {
+    uint8_t next = (transferHead + 1 == TRANSFER_QUEUE_SIZE) ? 0 : transferHead + 1;
+
+    while (next == transferTail) {
+        if (transferTail == transferRelease) {
+            // Only the held frame is left and it does not fit, so it has
+            // to be sent in parts
+            release_queued();
+        }
+
+        if (!(SREG & (1 << SREG_I))) {
+            // Interrupts are off so the timer will never drain the queue
+            delay_us(TRANSFER_TICK_US);
+            transfer_step();
+        }
+    }
+
+    transferQueue[transferHead] = transfer;
+    transferHead = next;
+
+    if (!transferHeld) {
+        release_queued();
+    }
+}
+
+/** 
+ * @brief Hold new transfers in the queue so a whole frame is queued before
+ * any of it is clocked out. Transfers released before this carry on and
+ * the timer stops at the first held transfer.
+ * 
+ */
+static void hold_transfers(void) {
+    transferHeld = true;
+}
+
+/** 
+ * @brief Start clocking out the transfers queued since hold_transfers so
+ * every device of the frame is sent back to back
+ * 
+ */
+static void release_transfers(void) {
+    transferHeld = false;
+    release_queued();
+}
+
+/** 
+ * @brief Queue a byte for a device
+ * @param device the device to send to
+ * @param byte the byte to send
+ * @param flags TRANSFER_START and/or TRANSFER_STOP
+ * 
+ */
+static void queue_byte(struct TM1638Device* device, uint8_t byte, uint8_t flags) {
+    struct TM1638Transfer transfer = {
+        .byte = byte,
+        .flags = flags,
+    };
+#if TM1638_FAST_TRANSPORT
+    transfer.stbMask = (1 << device->stbPinNum);
+    transfer.clkDelay = device->_clkDelay;
+#else
+    transfer.device = device;
+#endif
+
+    queue_transfer(transfer);
+}
+
+/** 
+ * @brief Queue a single byte command to several devices sharing the bus.
+ * With the fast transport every stb pin is pulled low together so the
+ * command is only clocked once at the speed of the slowest device.
+ * @param devices the devices to send to
+ * @param numDevices the number of devices
+ * @param command the command byte
+ * 
+ */
+static void queue_shared_command(struct TM1638Device* devices[], uint8_t numDevices, uint8_t command) {
+    if (numDevices == 0) {
+        return;
+    }
+
+#if TM1638_FAST_TRANSPORT
+    struct TM1638Transfer transfer = {
+        .stbMask = 0,
+        .clkDelay = 0,
+        .byte = command,
+        .flags = TRANSFER_START | TRANSFER_STOP,
+    };
+
+    for (uint8_t i = 0; i < numDevices; i++) {
+        transfer.stbMask |= (1 << devices[i]->stbPinNum);
+        if (devices[i]->_clkDelay > transfer.clkDelay) {
+            transfer.clkDelay = devices[i]->_clkDelay;
+        }
+    }
+
+    queue_transfer(transfer);
+#else
+    for (uint8_t i = 0; i < numDevices; i++) {
+        queue_byte(devices[i], command, TRANSFER_START | TRANSFER_STOP);
+    }
+#endif
+}
+
+int tm1638_init(struct TM1638Device* device, uint8_t stbPinNum, pin_t dataPin, pin_t clockPin) {
+    device->stbPinNum = stbPinNum;
+    device->stbPin = DISP_PIN(stbPinNum);
     device->dataPin = dataPin;
     device->clockPin = clockPin;
-    device->_dots = 0;
-    device->_digits_enables = 0xFF;
     device->_brightness = 0x0;
+    device->_ramValid = false;
+    for (uint8_t i = 0; i < TM1638_RAM_SIZE; i++) {
+        device->_ram[i] = 0x0;
+        device->_staged[i] = 0x0;
+    }
+    device->_control = CONTROL_BYTE | DISP_ON_BYTE | device->_brightness; // Sent by the start up
+    device->_controlPending = false;
+    device->_deferred = false;
+    device->_addressMode = UNKNOWN_ADDRESS_MODE;
+    device->_clkDelay = CLK_DELAY_LOOPS(TM1638_CLK_HALF_US);
+
+    static bool transferInitialised = false;
+    if (!transferInitialised) {
+        transfer_init();
+        transferInitialised = true;
+    }
 
-    GPIO_pin_init(device->dataPin, INPUT_NO_PULLUP);
-    GPIO_pin_init(device->clockPin, INPUT_NO_PULLUP);
-    GPIO_pin_init(device->stbPin, OUTPUT);
+    GPIO_set_output(device->dataPin, true);
+    GPIO_pin_init(device->dataPin, OUTPUT);
+    GPIO_set_output(device->clockPin, true);
+    GPIO_pin_init(device->clockPin, OUTPUT);
     GPIO_set_output(device->stbPin, true);
+    GPIO_pin_init(device->stbPin, OUTPUT);
+
+    device->_initState = TM1638_INIT_START;
+
+#if TM1638_FAST_TRANSPORT
+    if (!(STB_PINS_MASK & (1 << device->stbPinNum))) {
+        return 1; // Not listed in DISP_STB_PINS
+    }
+#endif
+
+    return 0;
+}
 
-    int result = 0;
-    send_start(*device);
-    send_byte(*device, CONTROL_BYTE | DISP_ON_BYTE | 0x0);
-    send_stop(*device);
+static bool calibrate_step(struct TM1638Device* device);
 
-    delay_ms(200);
+bool tm1638_init_update(struct TM1638Device* device) {
+    uint32_t now = uptime_ms();
 
-    send_start(*device);
-    send_byte(*device, CONTROL_BYTE | DISP_OFF_BYTE);
-    send_stop(*device);
+    switch (device->_initState) {
+    case TM1638_INIT_START:
+        queue_byte(device, CONTROL_BYTE | DISP_ON_BYTE | 0x0, TRANSFER_START | TRANSFER_STOP);
+        device->_initTime = now;
+        device->_initState = TM1638_INIT_DISPLAY_OFF;
+        break;
 
-    delay_ms(200);
+    case TM1638_INIT_DISPLAY_OFF:
+        if (now - device->_initTime >= INIT_DELAY_MS) {
+            queue_byte(device, CONTROL_BYTE | DISP_OFF_BYTE, TRANSFER_START | TRANSFER_STOP);
+            device->_initTime = now;
+            device->_initState = TM1638_INIT_DISPLAY_ON;
+        }
+        break;
+
+    case TM1638_INIT_DISPLAY_ON:
+        if (now - device->_initTime >= INIT_DELAY_MS) {
+            queue_byte(device, CONTROL_BYTE | DISP_ON_BYTE | 0x0, TRANSFER_START | TRANSFER_STOP);
+            device->_calibrationDelay = CLK_DELAY_LOOPS(TM1638_CALIBRATION_SLOW_US);
+            device->_calibrationFastest = 0;
+            device->_initState = TM1638_INIT_CALIBRATE;
+        }
+        break;
+
+    case TM1638_INIT_CALIBRATE:
+        // Calibration drives the bus directly so wait for the queue to empty
+        if ((transferHead == transferTail) && calibrate_step(device)) {
+            if (!tm1638_calibrated(device)) {
+                printf("%s: clock calibration failed, using the slowest clock\n", device->name);
+            }
+            device->_initState = TM1638_INIT_READY;
+        }
+        break;
 
-    send_start(*device);
-    send_byte(*device, CONTROL_BYTE | DISP_ON_BYTE | 0x0);
-    send_stop(*device);
+    case TM1638_INIT_READY:
+        return true;
+    }
 
-    return result;
+    return false;
 }
 
-void tm1638_enable_dot(struct TM1638Device* device, uint8_t digit, bool enable) {
-    if (enable) {
-        device->_dots |= (1 << digit);
-    } else {
-        device->_dots &= ~(1 << digit);
+#if TM1638_FAST_TRANSPORT
+/** 
+ * @brief Clock a byte in lsb first using the fast transport, the device
+ * changes the data on the falling edge so it is sampled with the clock high
+ * @param clkDelay the half clock period in _delay_loop_1 loops
+ * 
+ * @return the byte read
+ */
+static uint8_t fast_read_byte(uint8_t clkDelay) {
+    uint8_t byte = 0;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        DISP_PORT &= ~(1 << DISP_CLK_PIN_NUM);
+        _delay_loop_1(clkDelay);
+        DISP_PORT |= (1 << DISP_CLK_PIN_NUM);
+        _delay_loop_1(clkDelay);
+        if (DISP_PORT_IN & (1 << DISP_DATA_PIN_NUM)) {
+            byte |= (1 << i);
+        }
+    }
+
+    return byte;
+}
+
+/** 
+ * @brief Read the key scan data and check it is valid. A device that missed
+ * the read command leaves the data line pulled high which sets the reserved
+ * bits.
+ * @param stbMask the DISP_PORT bit of the stb pin
+ * @param clkDelay the half clock period to test
+ * @param keys the buffer to read the KEY_SCAN_BYTES into
+ * 
+ * @return true if the reserved bits all read as 0
+ */
+static bool read_keys(uint8_t stbMask, uint8_t clkDelay, uint8_t keys[]) {
+    bool valid = true;
+
+    fast_start(stbMask);
+    fast_byte(DATA_BYTE | READ_KEY_BYTE, clkDelay);
+
+    DISP_DDR &= ~(1 << DISP_DATA_PIN_NUM);
+    DISP_PORT |= (1 << DISP_DATA_PIN_NUM); // Pull up
+    _delay_us(TM1638_WAIT_US);
+
+    for (uint8_t i = 0; i < KEY_SCAN_BYTES; i++) {
+        keys[i] = fast_read_byte(clkDelay);
+        if (keys[i] & KEY_SCAN_RESERVED_BITS) {
+            valid = false;
+        }
+    }
+
+    fast_stop(stbMask);
+    DISP_DDR |= (1 << DISP_DATA_PIN_NUM);
+
+    return valid;
+}
+
+/** 
+ * @brief Check if the device responds reliably at a clock period
+ * @param stbMask the DISP_PORT bit of the stb pin
+ * @param clkDelay the half clock period to test
+ * 
+ * @return true if every key scan was valid and matched the first
+ */
+static bool clock_period_passes(uint8_t stbMask, uint8_t clkDelay) {
+    uint8_t expected[KEY_SCAN_BYTES];
+    uint8_t keys[KEY_SCAN_BYTES];
+
+    if (!read_keys(stbMask, clkDelay, expected)) {
+        return false;
+    }
+
+    for (uint8_t read = 1; read < TM1638_CALIBRATION_READS; read++) {
+        if (!read_keys(stbMask, clkDelay, keys)) {
+            return false;
+        }
+
+        for (uint8_t i = 0; i < KEY_SCAN_BYTES; i++) {
+            if (keys[i] != expected[i]) {
+                return false;
+            }
+        }
     }
+
+    return true;
 }
 
-void tm1638_enable_digit(struct TM1638Device* device, uint8_t digit, bool enable) {
-    if (enable) {
-        device->_digits_enables |= (1 << digit);
+/** 
+ * @brief Test the next calibration clock period, halving it each step until
+ * a period fails. The fastest passing period with a safety margin is then
+ * stored in the device.
+ * @param device the device being calibrated
+ * 
+ * @return true once calibration is finished
+ */
+static bool calibrate_step(struct TM1638Device* device) {
+    uint8_t stbMask = (1 << device->stbPinNum);
+
+    DISP_DDR |= (1 << DISP_CLK_PIN_NUM) | (1 << DISP_DATA_PIN_NUM);
+
+    bool passed = clock_period_passes(stbMask, device->_calibrationDelay);
+    if (passed) {
+        device->_calibrationFastest = device->_calibrationDelay;
+    }
+
+    device->_calibrationDelay /= 2;
+    if (passed && (device->_calibrationDelay > 0)) {
+        return false;
+    }
+
+    // The read command replaced the write data command
+    device->_addressMode = UNKNOWN_ADDRESS_MODE;
+
+    if (device->_calibrationFastest != 0) {
+        uint16_t clkDelay = device->_calibrationFastest * TM1638_CALIBRATION_MARGIN;
+        device->_clkDelay = (clkDelay > UINT8_MAX) ? UINT8_MAX : clkDelay;
     } else {
-        device->_digits_enables &= ~(1 << digit);
+        // Not even the slowest period passed, so the bus is marginal and
+        // the datasheet minimum is the worst choice
+        device->_clkDelay = CLK_DELAY_LOOPS(TM1638_CALIBRATION_SLOW_US);
     }
+
+    return true;
+}
+#else
+static bool calibrate_step(struct TM1638Device* device) {
+    // The GPIO transport has a fixed slow clock so there is nothing to find
+    device->_calibrationFastest = device->_clkDelay;
+    return true;
 }
+#endif
 
-int tm1638_write_digits(struct TM1638Device* device, uint8_t startingDigit, uint8_t values[], uint8_t valueLen) {
-    // printf("Writing startingDigit %d with value 0x%x\n", startingDigit, value);
+int tm1638_calibrate(struct TM1638Device* device) {
+    device->_calibrationDelay = CLK_DELAY_LOOPS(TM1638_CALIBRATION_SLOW_US);
+    device->_calibrationFastest = 0;
 
-    uint8_t data = DATA_BYTE | WRITE_DATA_BYTE | AUTO_ADDRESS_BYTE | NORMAL_MODE_BYTE;
+    while (!calibrate_step(device)) {
+        continue;
+    }
+
+    return tm1638_calibrated(device) ? 0 : 1;
+}
+
+bool tm1638_calibrated(const struct TM1638Device* device) {
+    return device->_calibrationFastest != 0;
+}
+
+/** 
+ * @brief Check if a display RAM address needs to be sent. The display
+ * interface already skips unchanged frames, this finer diff stays as the
+ * interface passes one span per display while the runs here split around
+ * unchanged digits.
+ * @param device the device to check
+ * @param address the address to check
+ * 
+ * @return true if the staged byte differs from the shadow
+ */
+static bool ram_dirty(struct TM1638Device* device, uint8_t address) {
+    return !device->_ramValid || (device->_staged[address] != device->_ram[address]);
+}
 
-    send_start(*device);
-    send_byte(*device, data);
-    send_stop(*device);
+/** 
+ * @brief Find the next run of changed bytes, runs are joined across a single
+ * unchanged byte as that costs the same as a new address byte
+ * @param device the device to check
+ * @param address the address to start from, set to the start of the run
+ * 
+ * @return the length of the run or 0 if there are no more changes
+ */
+static uint8_t find_run(struct TM1638Device* device, uint8_t* address) {
+    while ((*address < TM1638_RAM_SIZE) && !ram_dirty(device, *address)) {
+        (*address)++;
+    }
 
+    if (*address >= TM1638_RAM_SIZE) {
+        return 0;
+    }
 
-    send_start(*device);
-    send_byte(*device, ADDR_BYTE | (startingDigit * 2));
+    uint8_t end = *address + 1;
+    while ((end < TM1638_RAM_SIZE) && (ram_dirty(device, end)
+        || ((end + 1 < TM1638_RAM_SIZE) && ram_dirty(device, end + 1)))) {
+        end++;
+    }
 
-    for (uint8_t i = 0; i < valueLen; i++) {
-        uint8_t valueSeg = HexTo7Seg[values[i]];
+    return end - *address;
+}
 
-        if ((device->_dots >> (startingDigit + i)) & 1) {
-            valueSeg |= (1 << 7);
+/** 
+ * @brief Get the address mode used for a run of changed bytes, single bytes
+ * use fixed address mode and longer runs use auto increment mode
+ * @param runLen the length of the run
+ * 
+ * @return either FIXED_ADDRESS_BYTE or AUTO_ADDRESS_BYTE
+ */
+static uint8_t run_address_mode(uint8_t runLen) {
+    return (runLen == 1) ? FIXED_ADDRESS_BYTE : AUTO_ADDRESS_BYTE;
+}
+
+/** 
+ * @brief Check if a device has a run of changed bytes using an address mode
+ * @param device the device to check
+ * @param addressMode the address mode to look for
+ * 
+ * @return true if there is a run using the address mode
+ */
+static bool has_run(struct TM1638Device* device, uint8_t addressMode) {
+    uint8_t address = 0;
+    uint8_t runLen;
+
+    while ((runLen = find_run(device, &address)) != 0) {
+        if (run_address_mode(runLen) == addressMode) {
+            return true;
         }
-        if (!((device->_digits_enables >> (startingDigit + i)) & 1)) {
-            valueSeg = 0;
+        address += runLen;
+    }
+
+    return false;
+}
+
+/** 
+ * @brief Queue every run of changed bytes using an address mode and update
+ * the shadow display RAM
+ * @param device the device to write to
+ * @param addressMode the address mode of the runs to send
+ * 
+ */
+static void queue_runs(struct TM1638Device* device, uint8_t addressMode) {
+    uint8_t address = 0;
+    uint8_t runLen;
+
+    while ((runLen = find_run(device, &address)) != 0) {
+        uint8_t end = address + runLen;
+
+        if (run_address_mode(runLen) != addressMode) {
+            address = end;
+            continue;
         }
 
-        send_byte(*device, valueSeg);
-        send_byte(*device, 0x0);
+        queue_byte(device, ADDR_BYTE | address, TRANSFER_START);
+        for (; address < end; address++) {
+            queue_byte(device, device->_staged[address], (address + 1 == end) ? TRANSFER_STOP : 0);
+            device->_ram[address] = device->_staged[address];
+        }
     }
+}
+
+/** 
+ * @brief Queue the pending control commands and changed display RAM of
+ * devices sharing the bus. Devices needing the same command share one
+ * transfer, then the runs of each device are sent grouped by address mode
+ * so the data command is only sent when the address mode changes. The
+ * whole update is queued before it is clocked out so every device changes
+ * in one burst.
+ * @param devices the devices to flush
+ * @param numDevices the number of devices
+ * 
+ */
+static void flush_devices(struct TM1638Device* devices[], uint8_t numDevices) {
+    struct TM1638Device* shared[DISPLAY_MAX_GROUP];
+    uint8_t numShared;
 
-    send_stop(*device);
+    hold_transfers();
 
-    return 0;
-}
+    for (uint8_t i = 0; i < numDevices; i++) {
+        if (!devices[i]->_controlPending) {
+            continue;
+        }
+
+        numShared = 0;
+        for (uint8_t j = i; j < numDevices; j++) {
+            if (devices[j]->_controlPending && (devices[j]->_control == devices[i]->_control)) {
+                shared[numShared++] = devices[j];
+            }
+        }
+
+        queue_shared_command(shared, numShared, devices[i]->_control);
 
-int tm1638_write(struct TM1638Device* device, uint32_t value, char* format) {
-    // printf("Attempting to write to \"%s\" value: 0x%lx\n", device.name, value);
-    uint8_t digits[6] = { 0 };
-    if ((char)(format[1]) == 'x') {
-        // Hex
+        for (uint8_t j = 0; j < numShared; j++) {
+            shared[j]->_controlPending = false;
+        }
+    }
 
-        for (uint8_t i = 6; i > 0; i--) {
-            digits[i - 1] = value % 16;
-            value /= 16;
+    const uint8_t addressModes[] = { FIXED_ADDRESS_BYTE, AUTO_ADDRESS_BYTE };
+    for (uint8_t mode = 0; mode < sizeof(addressModes); mode++) {
+        uint8_t addressMode = addressModes[mode];
+
+        numShared = 0;
+        for (uint8_t i = 0; i < numDevices; i++) {
+            if ((devices[i]->_addressMode != addressMode) && has_run(devices[i], addressMode)) {
+                shared[numShared++] = devices[i];
+                devices[i]->_addressMode = addressMode;
+            }
         }
 
+        queue_shared_command(shared, numShared, DATA_BYTE | WRITE_DATA_BYTE | addressMode | NORMAL_MODE_BYTE);
 
-    } else {
-        for (uint8_t i = 6; i > 0; i--) {
-            digits[i - 1] = value % 10;
-            value /= 10;
+        for (uint8_t i = 0; i < numDevices; i++) {
+            queue_runs(devices[i], addressMode);
         }
     }
 
-    tm1638_write_digits(device, 0, digits, 6);
+    for (uint8_t i = 0; i < numDevices; i++) {
+        devices[i]->_ramValid = true;
+    }
+
+    release_transfers();
+}
+
+/** 
+ * @brief Flush a device unless the display interface is collecting changes
+ * @param device the device to flush
+ * 
+ */
+static void flush_device(struct TM1638Device* device) {
+    if (!device->_deferred) {
+        flush_devices(&device, 1);
+    }
+}
+
+int tm1638_write_segments(struct TM1638Device* device, uint8_t startingDigit, const uint8_t segments[], uint8_t segmentsLen) {
+    if (startingDigit + segmentsLen > TM1638_NUM_GRIDS) {
+        return 1;
+    }
+
+    for (uint8_t i = 0; i < segmentsLen; i++) {
+        uint8_t digit = startingDigit + i;
+
+        device->_staged[digit * 2] = segments[i];
+        device->_staged[digit * 2 + 1] = 0x0;
+    }
+
+    flush_device(device);
 
     return 0;
 }
 
-void tm1638_reset(struct TM1638Device* device) {
-    device->_dots = 0;
-    device->_digits_enables = 0xFF;
+void tm1638_format_decimal(uint32_t value, uint8_t segments[], bool leadingZeros) {
+    static const uint32_t powersOfTen[] = {
+        1000000000, 100000000, 10000000, 1000000, // Dropped
+        100000, 10000, 1000, 100, 10, 1
+    };
+    const uint8_t dropped = sizeof(powersOfTen) / sizeof(powersOfTen[0]) - TM1638_DIGITS;
+
+    for (uint8_t i = 0; i < dropped; i++) {
+        while (value >= powersOfTen[i]) {
+            value -= powersOfTen[i];
+        }
+    }
+
+    bool blank = !leadingZeros;
+    for (uint8_t i = 0; i < TM1638_DIGITS; i++) {
+        uint32_t power = powersOfTen[dropped + i];
+        uint8_t digit = 0;
 
-    tm1638_set_display_state(device, true);
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+
+        if (digit != 0 || i == TM1638_DIGITS - 1) {
+            blank = false;
+        }
+        segments[i] = blank ? 0x0 : HexTo7Seg[digit];
+    }
 }
 
 void tm1638_set_display_state(struct TM1638Device* device, bool state) {
-    send_start(*device);
     if (state) {
-        send_byte(*device, CONTROL_BYTE | DISP_ON_BYTE | device->_brightness);
+        device->_control = CONTROL_BYTE | DISP_ON_BYTE | device->_brightness;
     } else {
-        send_byte(*device, CONTROL_BYTE | DISP_OFF_BYTE);
+        device->_control = CONTROL_BYTE | DISP_OFF_BYTE;
     }
-    send_stop(*device);
+    device->_controlPending = true;
+
+    flush_device(device);
 }
 
 void tm1638_set_brightness(struct TM1638Device* device, uint8_t brightness) {
     device->_brightness = brightness;
-    send_start(*device);
-    send_byte(*device, CONTROL_BYTE | DISP_ON_BYTE | device->_brightness);
-    send_stop(*device);
-}
\ No newline at end of file
+    if (device->_control & DISP_ON_BYTE) {
+        device->_control = CONTROL_BYTE | DISP_ON_BYTE | device->_brightness;
+        device->_controlPending = true;
+    }
+
+    flush_device(device);
+}
+
+// Display interface backend, changes are deferred until the flush so every
+// display on the bus is sent together
+static bool backend_init_update(void* backend) {
+    return tm1638_init_update(backend);
+}
+
+static int backend_write(void* backend, const uint8_t segments[], uint8_t start, uint8_t len) {
+    struct TM1638Device* device = backend;
+    device->_deferred = true;
+
+    return tm1638_write_segments(device, start, &segments[start], len);
+}
+
+static void backend_flush(void* backends[], uint8_t numBackends) {
+    struct TM1638Device* devices[DISPLAY_MAX_GROUP];
+    for (uint8_t i = 0; i < numBackends; i++) {
+        devices[i] = backends[i];
+        devices[i]->_deferred = false;
+    }
+
+    flush_devices(devices, numBackends);
+}
+
+static void backend_set_brightness(void* backend, uint8_t brightness) {
+    struct TM1638Device* device = backend;
+    device->_deferred = true;
+
+    tm1638_set_brightness(device, brightness);
+}
+
+static void backend_set_power(void* backend, bool on) {
+    struct TM1638Device* device = backend;
+    device->_deferred = true;
+
+    tm1638_set_display_state(device, on);
+}
+
+const struct DisplayDeviceOps tm1638DisplayOps = {
+    .init_update = backend_init_update,
+    .write = backend_write,
+    .flush = backend_flush,
+    .set_brightness = backend_set_brightness,
+    .set_power = backend_set_power,
+};
+
+#ifdef TM1638_BENCHMARK
+/** 
+ * @brief The division based decimal conversion replaced by
+ * tm1638_format_decimal, kept for comparison
+ * 
+ */
+static void decimal_to_segments_div(uint32_t value, uint8_t segments[]) {
+    for (uint8_t i = TM1638_DIGITS; i > 0; i--) {
+        segments[i - 1] = HexTo7Seg[value % 10];
+        value /= 10;
+    }
+}
+
+void tm1638_benchmark(struct TM1638Device* device) {
+    // The printfs below share the UART with the host packets, bench builds only
+    // Bytes are clocked with every stb pin high so no device latches them
+    sei(); // uptime needs its timer interrupt
+
+    uint16_t gpioBytes = 16;
+    uint64_t start = uptime_ms();
+    for (uint16_t i = 0; i < gpioBytes; i++) {
+        send_byte(device, 0xA5);
+    }
+    uint32_t gpioTime = uptime_ms() - start;
+
+    uint16_t fastBytes = 4096;
+    start = uptime_ms();
+    for (uint16_t i = 0; i < fastBytes; i++) {
+        fast_byte(0xA5, device->_clkDelay);
+    }
+    uint32_t fastTime = uptime_ms() - start;
+
+    printf("TM1638 GPIO transport: %u bytes in %lu ms = %lu bytes/s\n", gpioBytes,
+        gpioTime, gpioTime ? (gpioBytes * 1000UL) / gpioTime : 0);
+    printf("TM1638 fast transport: %u bytes in %lu ms = %lu bytes/s\n", fastBytes,
+        fastTime, fastTime ? (fastBytes * 1000UL) / fastTime : 0);
+
+    // Conversions of a worst case frequency
+    volatile uint32_t value = 137975;
+    uint8_t segments[TM1638_DIGITS];
+    uint16_t conversions = 1000;
+
+    start = uptime_ms();
+    for (uint16_t i = 0; i < conversions; i++) {
+        decimal_to_segments_div(value, segments);
+    }
+    uint32_t divTime = uptime_ms() - start;
+
+    start = uptime_ms();
+    for (uint16_t i = 0; i < conversions; i++) {
+        tm1638_format_decimal(value, segments, false);
+    }
+    uint32_t subTime = uptime_ms() - start;
+
+    printf("TM1638 division conversion: %lu cycles\n", divTime * (F_CPU / 1000UL) / conversions);
+    printf("TM1638 subtraction conversion: %lu cycles\n", subTime * (F_CPU / 1000UL) / conversions);
+}
+#endif
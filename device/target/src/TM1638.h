@@ -14,77 +14,120 @@
 
 #include "avr_extends/GPIO.h"
 
+#include "display_device.h"
+
+#define TM1638_NUM_GRIDS 8 // Number of digit grids on the device
+#define TM1638_DIGITS 6 // Number of digits filled by tm1638_format_decimal
+#define TM1638_RAM_SIZE 16 // Bytes of display RAM, two per grid
+
+/// @brief The steps of the non blocking start up
+typedef enum TM1638InitState_e {
+    TM1638_INIT_START,
+    TM1638_INIT_DISPLAY_OFF,
+    TM1638_INIT_DISPLAY_ON,
+    TM1638_INIT_CALIBRATE,
+    TM1638_INIT_READY,
+} TM1638InitState_t;
+
 struct TM1638Device {
     pin_t dataPin; // The data signal pin
     pin_t clockPin; // The clock signal pin
-    pin_t stbPin; // The stb signal pin
+    pin_t stbPin; // The stb signal pin, built from stbPinNum
+    uint8_t stbPinNum; // The stb pin number on DISP_PORT, must be in DISP_STB_PINS
     char* name;
 
     // Private
-    uint8_t _dots; // The dots to display 
-    uint8_t _digits_enables; // The digit enables
     uint8_t _brightness; // The brightness of the display
+    uint8_t _ram[TM1638_RAM_SIZE]; // Shadow copy of the device display RAM
+    uint8_t _staged[TM1638_RAM_SIZE]; // Display RAM waiting to be sent
+    bool _ramValid; // True once _ram is known to match the device
+    uint8_t _control; // The control command waiting to be sent
+    bool _controlPending; // True if _control needs to be sent
+    bool _deferred; // True while the display interface is collecting changes to flush
+    uint8_t _addressMode; // The address mode set by the last data command
+    uint8_t _clkDelay; // Calibrated fast transport half clock in _delay_loop_1 loops
+    TM1638InitState_t _initState; // Progress of the start up
+    uint32_t _initTime; // Time of the last start up step in ms
+    uint8_t _calibrationDelay; // Next clock period to try while calibrating
+    uint8_t _calibrationFastest; // Fastest clock period that has passed
 };
 
+// The display interface backend, the backend pointer is a struct TM1638Device
+extern const struct DisplayDeviceOps tm1638DisplayOps;
+
 /**
- * @brief Initialise a new driver
+ * @brief Initialise a new driver, this does not block and the device is
+ * brought up by calling tm1638_init_update
  * @param device The device struct to initialise
- * @param stbPin The stb pin
+ * @param stbPinNum The stb pin number on DISP_PORT
  * @param dataPin The data pin
  * @param clockPin The clock pin
  * 
- * @return 0 if successful
+ * @return 0 if successful, 1 if stbPinNum is not in DISP_STB_PINS
  */
-int tm1638_init(struct TM1638Device* device, pin_t stbPin, pin_t dataPin, pin_t clockPin);
+int tm1638_init(struct TM1638Device* device, uint8_t stbPinNum, pin_t dataPin, pin_t clockPin);
 
-/**
- * @brief Enable a dot
- * @param device the device struct to manupulate
- * @param digit the digit to change
- * @param enable true to enable the dot
- *
+/** 
+ * @brief Advance the start up of a device, this must be called regularly
+ * with interrupts enabled until it returns true. The display commands are
+ * spaced out using uptime and the clock is then calibrated one period per
+ * call. If calibration fails the slowest calibration clock is used and the
+ * failure is printed.
+ * @param device the device to bring up
+ * 
+ * @return true once the device is ready to be written to
  */
-void tm1638_enable_dot(struct TM1638Device* device, uint8_t digit, bool enable);
+bool tm1638_init_update(struct TM1638Device* device);
 
 /** 
- * @brief Enable digits to be displayed
- * @param device the struct to manupulate
- * @param digit the digit to change
- * @param enable true to enable the digit
+ * @brief Find the fastest clock the device reliably responds to by reading
+ * the key scan data at shorter and shorter clock periods. The fastest
+ * passing period with a safety margin is used for all later transfers, if
+ * no period passes the slowest period is used. This blocks and must not be
+ * called while transfers are queued.
+ * @param device the device to calibrate
  * 
+ * @return 0 if successful or the GPIO transport is used, 1 if no period
+ * passed
  */
-void tm1638_enable_digit(struct TM1638Device* device, uint8_t digit, bool enable);
+int tm1638_calibrate(struct TM1638Device* device);
 
-/**
- * @brief Write to the display a value
- * @param device the device struct to write to
- * @param value the value to write where each hex digit is the displayed value
- * @param format the format to use ether "%x" or "%d"
- *
- * @return 0 if successful
+/** 
+ * @brief Check if the last calibration found a clock the device responds to
+ * @param device the device to check
+ * 
+ * @return true if calibrated, always true with the GPIO transport once the
+ * start up has finished
  */
-int tm1638_write(struct TM1638Device* device, uint32_t value, char* format);
+bool tm1638_calibrated(const struct TM1638Device* device);
+
+/** 
+ * @brief Convert a value to decimal segment bytes by subtracting powers of
+ * ten, avoiding the 32 bit division library calls. Digits above
+ * TM1638_DIGITS are dropped.
+ * @param value the value to convert
+ * @param segments the TM1638_DIGITS segment bytes to fill, msd first
+ * @param leadingZeros true to show leading zeros, otherwise they are blank
+ * 
+ */
+void tm1638_format_decimal(uint32_t value, uint8_t segments[], bool leadingZeros);
 
 /**
- * @brief Write digits to the display
+ * @brief Write segment bytes to the display only sending the bytes that
+ * differ from the shadow display RAM. The bytes are queued and sent by the
+ * timer 2 interrupt.
  * @param device the device struct to use
  * @param startingDigit the starting digit to write to
- * @param values the values to write
- * @param valueLen the length of the values array
+ * @param segments the segment bytes to write, bit 0 is segment a
+ * @param segmentsLen the length of the segments array
  *
- * @return 0 if successful
- */
-int tm1638_write_digits(struct TM1638Device* device, uint8_t startingDigit, uint8_t values[], uint8_t valueLen);
-
-/** 
- * @brief Clear the screen turning off all dots and on all digits
- * @param device the device struct to use
- * 
+ * @return 0 if successful, 1 if the digits are out of range
  */
-void tm1638_reset(struct TM1638Device* device);
+int tm1638_write_segments(struct TM1638Device* device, uint8_t startingDigit, const uint8_t segments[], uint8_t segmentsLen);
 
 /** 
- * @brief Control whether the display is on or off
+ * @brief Control whether the display is on or off. The command is queued
+ * and sent by the timer 2 interrupt.
  * @param device the device struct to use
  * @param state true to turn on the display
  * 
@@ -92,12 +135,25 @@ void tm1638_reset(struct TM1638Device* device);
 void tm1638_set_display_state(struct TM1638Device* device, bool state);
 
 /** 
- * @brief Control the display brightness
+ * @brief Control the display brightness, a display that is off stays off.
+ * The command is queued and sent by the timer 2 interrupt.
  * @param device the device struct to use
  * @param brightness the brightness to set 0-7
  * 
  */
 void tm1638_set_brightness(struct TM1638Device* device, uint8_t brightness);
 
+#ifdef TM1638_BENCHMARK
+/** 
+ * @brief Measure and print the bytes per second of the GPIO and fast
+ * transports. This enables interrupts so uptime can run.
+ * The results are printed on stdout, which is the UART the host protocol
+ * runs on, so TM1638_BENCHMARK must never be defined in a deployed build.
+ * @param device an initialised device to borrow the pins from
+ * 
+ */
+void tm1638_benchmark(struct TM1638Device* device);
+#endif
+
 
 #endif // TM1638_H
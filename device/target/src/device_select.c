@@ -21,6 +21,7 @@
 #include "device_select.h"
 
 uint8_t selectedDevice_prev = 0;
+static uint8_t selectVersion = 0; // Incremented whenever the device changes
 
 int device_select_init(void) {
     GPIO_pin_init(DEVICE_SELECT_0_PIN, INPUT_NO_PULLUP);
@@ -36,6 +37,10 @@ uint8_t device_select_get(void) {
     return selectedDevice_prev;
 }
 
+uint8_t device_select_get_version(void) {
+    return selectVersion;
+}
+
 uint16_t device_select_packet_assemble(uint8_t* buffer) {
     uint8_t bufferLength = 0;
 
@@ -61,6 +66,10 @@ bool device_select_update(void) {
     bool result = selectedDevice_prev != value;
     selectedDevice_prev = value;
 
+    if (result) {
+        selectVersion++;
+    }
+
     return result;
 }
 
@@ -29,6 +29,14 @@ int device_select_init(void);
  */
 uint8_t device_select_get(void);
 
+/** 
+ * @brief Get the device select change counter, this is incremented whenever
+ * the selected device changes
+ * 
+ * @return the change counter
+ */
+uint8_t device_select_get_version(void);
+
 /**
  * @brief Assemble a radio device select payload to be sent
  * @param buffer the buffer to load into
@@ -0,0 +1,222 @@
+/**
+ * @file display_device.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Implementation of the common display interface
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "display_device.h"
+
+// Digits
+const uint8_t HexTo7Seg[40] =
+{
+  0x3F, // 0
+  0x06, // 1
+  0x5B, // 2
+  0x4F, // 3
+  0x66, // 4
+  0x6D, // 5
+  0x7D, // 6
+  0x07, // 7
+  0x7F, // 8
+  0x6F, // 9
+  0x77, // A
+  0x7c, // b
+  0x39, // C
+  0x5E, // d
+  0x79, // E
+  0x71, // F
+  0x6F, // g
+  0x3D, // G
+  0x74, // h
+  0x76, // H
+  0x05, // i
+  0x06, // I
+  0x0D, // j
+  0x30, // l
+  0x38, // L
+  0x54, // n
+  0x37, // N
+  0x5C, // o
+  0x3F, // O
+  0x73, // P
+  0x67, // q
+  0x50, // r
+  0x6D, // S
+  0x78, // t
+  0x1C, // u
+  0x3E, // U
+  0x66, // y
+  0x08, // _
+  0x40, // -
+  0x01  // Overscore
+};
+
+int display_device_init(struct DisplayDevice* display, const struct DisplayDeviceOps* ops, void* backend,
+    uint8_t numDigits) {
+    if (numDigits > DISPLAY_MAX_DIGITS) {
+        return 1;
+    }
+
+    display->ops = ops;
+    display->backend = backend;
+    display->numDigits = numDigits;
+
+    memset(&display->_back, 0, sizeof(display->_back));
+    display->_frontValid = false;
+    display->_power = true;
+    display->_brightness = DISPLAY_MAX_BRIGHTNESS;
+    display->_stateValid = false;
+    display->_effect = DISPLAY_EFFECT_NONE;
+    display->_effectMask = 0;
+    display->_effectVisible = true;
+    display->_effectDirty = false;
+
+    return 0;
+}
+
+bool display_device_init_update(struct DisplayDevice* display) {
+    return display->ops->init_update(display->backend);
+}
+
+struct DisplayFrame* display_device_back_buffer(struct DisplayDevice* display) {
+    return &display->_back;
+}
+
+void display_device_set_brightness(struct DisplayDevice* display, uint8_t brightness) {
+    if (brightness > DISPLAY_MAX_BRIGHTNESS) {
+        brightness = DISPLAY_MAX_BRIGHTNESS;
+    }
+
+    display->_brightness = brightness;
+}
+
+void display_device_set_power(struct DisplayDevice* display, bool on) {
+    display->_power = on;
+}
+
+void display_device_set_effect(struct DisplayDevice* display, DisplayEffect_t effect, uint8_t digitMask) {
+    if ((effect != display->_effect) || (digitMask != display->_effectMask)) {
+        display->_effect = effect;
+        display->_effectMask = digitMask;
+        display->_effectDirty = true;
+    }
+}
+
+bool display_device_tick(struct DisplayDevice* displays[], uint8_t numDisplays, uint32_t now) {
+    bool changed = false;
+
+    for (uint8_t i = 0; i < numDisplays; i++) {
+        struct DisplayDevice* display = displays[i];
+        bool visible = true;
+
+        if (display->_effect == DISPLAY_EFFECT_BLINK) {
+            visible = !((now >> DISPLAY_BLINK_SHIFT) & 1);
+        } else if (display->_effect == DISPLAY_EFFECT_FLASH) {
+            visible = !((now >> DISPLAY_FLASH_SHIFT) & 1);
+        }
+
+        if (display->_effectDirty || (visible != display->_effectVisible)) {
+            changed = true;
+        }
+        display->_effectVisible = visible;
+        display->_effectDirty = false;
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Hand the power, brightness and changed digits of a display to its
+ * backend, applying the effect in its off phase
+ * @param display the display to update
+ *
+ * @return 0 if successful
+ */
+static int update_backend(struct DisplayDevice* display) {
+    const struct DisplayDeviceOps* ops = display->ops;
+
+    bool effectOff = !display->_effectVisible;
+    bool power = display->_power && !(effectOff && (display->_effect == DISPLAY_EFFECT_FLASH));
+
+    struct DisplayFrame frame = display->_back;
+    if (effectOff && (display->_effect == DISPLAY_EFFECT_BLINK)) {
+        for (uint8_t i = 0; i < display->numDigits; i++) {
+            if ((display->_effectMask >> i) & 1) {
+                frame.segments[i] = 0x0;
+            }
+        }
+    }
+
+    if (!display->_stateValid || (display->_brightness != display->_brightnessShown)) {
+        ops->set_brightness(display->backend, display->_brightness);
+        display->_brightnessShown = display->_brightness;
+    }
+
+    if (!display->_stateValid || (power != display->_powerShown)) {
+        ops->set_power(display->backend, power);
+        display->_powerShown = power;
+    }
+    display->_stateValid = true;
+
+    uint8_t first = 0;
+    uint8_t last = display->numDigits;
+
+    if (display->_frontValid) {
+        while ((first < last) && (frame.segments[first] == display->_front.segments[first])) {
+            first++;
+        }
+        while ((last > first) && (frame.segments[last - 1] == display->_front.segments[last - 1])) {
+            last--;
+        }
+    }
+
+    if (first == last) {
+        return 0;
+    }
+
+    int result = ops->write(display->backend, frame.segments, first, last - first);
+    if (result == 0) {
+        memcpy(display->_front.segments, frame.segments, display->numDigits);
+        display->_frontValid = true;
+    }
+
+    return result;
+}
+
+int display_device_commit(struct DisplayDevice* displays[], uint8_t numDisplays) {
+    if (numDisplays > DISPLAY_MAX_GROUP) {
+        return 1;
+    }
+
+    int result = 0;
+    for (uint8_t i = 0; i < numDisplays; i++) {
+        result |= update_backend(displays[i]);
+    }
+
+    // Flush each backend type once with all of its displays
+    bool flushed[DISPLAY_MAX_GROUP] = { false };
+    for (uint8_t i = 0; i < numDisplays; i++) {
+        if (flushed[i]) {
+            continue;
+        }
+
+        void* backends[DISPLAY_MAX_GROUP];
+        uint8_t numBackends = 0;
+        for (uint8_t j = i; j < numDisplays; j++) {
+            if (displays[j]->ops == displays[i]->ops) {
+                backends[numBackends++] = displays[j]->backend;
+                flushed[j] = true;
+            }
+        }
+
+        displays[i]->ops->flush(backends, numBackends);
+    }
+
+    return result;
+}
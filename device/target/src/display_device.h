@@ -0,0 +1,192 @@
+/**
+ * @file display_device.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Common interface over the seven segment display drivers. Frames
+ * are rendered into a back buffer per display and committed together, each
+ * back buffer is diffed against its front buffer and handed to the driver
+ * backend, which may batch several displays into one transfer.
+ */
+
+
+#ifndef DISPLAY_DEVICE_H
+#define DISPLAY_DEVICE_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DISPLAY_MAX_DIGITS 8 // Most digits a display frame holds
+#define DISPLAY_MAX_BRIGHTNESS 7
+#define DISPLAY_MAX_GROUP 4 // Most displays sharing a backend flush
+
+// Effect half periods as a power of two ms so the phase is a shift of uptime
+#ifndef DISPLAY_BLINK_SHIFT
+#define DISPLAY_BLINK_SHIFT 8 // 256ms on and 256ms off
+#endif
+#ifndef DISPLAY_FLASH_SHIFT
+#define DISPLAY_FLASH_SHIFT 7 // 128ms on and 128ms off
+#endif
+
+// Segment bytes for 0-F followed by letters and symbols
+extern const uint8_t HexTo7Seg[40];
+
+/// @brief The segments of every digit of a display, bit 0 is segment a
+/// and bit 7 is the dot. Index 0 is the left digit.
+struct DisplayFrame {
+    uint8_t segments[DISPLAY_MAX_DIGITS];
+};
+
+/// @brief Effects applied on top of the back buffer at each commit
+typedef enum DisplayEffect_e {
+    DISPLAY_EFFECT_NONE,
+    DISPLAY_EFFECT_BLINK, // Blank the effect digits every other blink period
+    DISPLAY_EFFECT_FLASH, // Turn the display off every other flash period
+} DisplayEffect_t;
+
+/// @brief The operations a display driver provides, the backend is the
+/// driver's own device struct
+struct DisplayDeviceOps {
+    /**
+     * @brief Advance the start up of the backend
+     *
+     * @return true once the backend can be written to
+     */
+    bool (*init_update)(void* backend);
+
+    /**
+     * @brief Write the changed digits of a frame, a backend may hold the
+     * write until flush
+     * @param segments the full frame
+     * @param start the first changed digit
+     * @param len the number of digits from start that changed
+     *
+     * @return 0 if successful
+     */
+    int (*write)(void* backend, const uint8_t segments[], uint8_t start, uint8_t len);
+
+    /**
+     * @brief Send everything held by a group of backends of this type
+     * @param backends the backends to send
+     * @param numBackends the length of backends
+     *
+     */
+    void (*flush)(void* backends[], uint8_t numBackends);
+
+    /**
+     * @brief Set the brightness 0-DISPLAY_MAX_BRIGHTNESS, a backend may hold
+     * the change until flush
+     *
+     */
+    void (*set_brightness)(void* backend, uint8_t brightness);
+
+    /**
+     * @brief Turn the display on or off, a backend may hold the change
+     * until flush
+     *
+     */
+    void (*set_power)(void* backend, bool on);
+};
+
+struct DisplayDevice {
+    const struct DisplayDeviceOps* ops; // The driver of the display
+    void* backend; // The driver device struct
+    uint8_t numDigits; // Digits shown by the display
+
+    // Private
+    struct DisplayFrame _back; // The frame being rendered, shown at the next commit
+    struct DisplayFrame _front; // The frame last handed to the backend
+    bool _frontValid; // True once _front has been handed to the backend
+    bool _power; // The requested power state
+    bool _powerShown; // The power state last handed to the backend
+    uint8_t _brightness; // The requested brightness
+    uint8_t _brightnessShown; // The brightness last handed to the backend
+    bool _stateValid; // True once the power and brightness have been handed over
+    DisplayEffect_t _effect; // The running effect
+    uint8_t _effectMask; // The digits blanked by the blink effect, bit 0 is the left digit
+    bool _effectVisible; // False in the off phase of the effect
+    bool _effectDirty; // True if the effect changed since the last tick
+};
+
+/**
+ * @brief Initialise a display over an initialised driver device. The display
+ * starts on at full brightness with every digit blank.
+ * @param display the display to initialise
+ * @param ops the driver operations
+ * @param backend the driver device struct
+ * @param numDigits the digits shown by the display
+ *
+ * @return 0 if successful, 1 if numDigits is too large
+ */
+int display_device_init(struct DisplayDevice* display, const struct DisplayDeviceOps* ops, void* backend,
+    uint8_t numDigits);
+
+/**
+ * @brief Advance the start up of a display, this must be called regularly
+ * until it returns true
+ * @param display the display to bring up
+ *
+ * @return true once the display is ready to be written to
+ */
+bool display_device_init_update(struct DisplayDevice* display);
+
+/**
+ * @brief Get the back buffer of a display to render into, it is shown at
+ * the next commit
+ * @param display the display to render to
+ *
+ * @return the back buffer
+ */
+struct DisplayFrame* display_device_back_buffer(struct DisplayDevice* display);
+
+/**
+ * @brief Set the brightness to use at the next commit
+ * @param display the display to change
+ * @param brightness the brightness 0-DISPLAY_MAX_BRIGHTNESS
+ *
+ */
+void display_device_set_brightness(struct DisplayDevice* display, uint8_t brightness);
+
+/**
+ * @brief Set whether the display is on at the next commit
+ * @param display the display to change
+ * @param on true to turn the display on
+ *
+ */
+void display_device_set_power(struct DisplayDevice* display, bool on);
+
+/**
+ * @brief Set the effect of a display, it is shown from the next tick
+ * @param display the display to change
+ * @param effect the effect to run
+ * @param digitMask the digits blanked by DISPLAY_EFFECT_BLINK, bit 0 is the
+ * left digit
+ *
+ */
+void display_device_set_effect(struct DisplayDevice* display, DisplayEffect_t effect, uint8_t digitMask);
+
+/**
+ * @brief Advance the effects of several displays. This only shifts the time
+ * and compares it so costs the same small amount every call.
+ * @param displays the displays to advance
+ * @param numDisplays the length of displays
+ * @param now the uptime in ms
+ *
+ * @return true if a display needs to be committed to show its effect
+ */
+bool display_device_tick(struct DisplayDevice* displays[], uint8_t numDisplays, uint32_t now);
+
+/**
+ * @brief Show the back buffers of several displays. Only what differs from
+ * each front buffer is handed to the backends, then the displays sharing a
+ * backend type are flushed together so they change back to back. Effects
+ * are applied on top of the back buffers.
+ * @param displays the displays to commit
+ * @param numDisplays the length of displays, at most DISPLAY_MAX_GROUP
+ *
+ * @return 0 if successful
+ */
+int display_device_commit(struct DisplayDevice* displays[], uint8_t numDisplays);
+
+
+#endif // DISPLAY_DEVICE_H
@@ -9,9 +9,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <avr/pgmspace.h>
+
+#include "avr_extends/uptime.h"
+
 #include "pin.h"
 
 #include "TM1638.h"
+#include "display_device.h"
 #include "freq_handler.h"
 #include "device_select.h"
 
@@ -28,86 +33,229 @@ struct TM1638Device disp1 = {
     .name = "Display 1",
 };
 
+#define NUM_DISPLAYS 2
+#define DISPLAY_BRIGHTNESS 0
+#define EDIT_BLINK_MS 2000 // Time the standby digits blink after the encoders stop
+
+// Most frames sent per second, changes within a frame are coalesced and the
+// latest values are shown at the start of the next frame
+#ifndef DISPLAY_MAX_FPS
+#define DISPLAY_MAX_FPS 30
+#endif
+#define DISPLAY_FRAME_MS (1000 / DISPLAY_MAX_FPS)
+
+#define DOT_SEGMENT (1 << 7)
+
+// The displays from left to right, indexes the layouts. Both share the data
+// and clock pins so are flushed together.
+struct DisplayDevice leftDisplay;
+struct DisplayDevice rightDisplay;
+struct DisplayDevice* displays[NUM_DISPLAYS] = { &leftDisplay, &rightDisplay };
+
+/// @brief The value a display shows
+typedef enum DisplaySource_e {
+    DISPLAY_OFF,
+    DISPLAY_ACTIVE,
+    DISPLAY_STANDBY,
+} DisplaySource_t;
+
+/// @brief How a display shows a radio, bit 0 of the masks is the left digit
+struct DisplayLayout {
+    uint8_t source; // The DisplaySource_t shown
+    uint8_t digitMask; // The digits that are shown
+    uint8_t dotMask; // The digits with their dot lit
+    bool leadingZeros; // True to show leading zeros
+};
+
+// The layout of each display for each radio, indexed by freqType_t
+static const struct DisplayLayout radioLayouts[][NUM_DISPLAYS] PROGMEM = {
+    [COM1] = {
+        { DISPLAY_ACTIVE, 0x3F, 0x04, false },
+        { DISPLAY_STANDBY, 0x3F, 0x04, false },
+    },
+    [COM2] = {
+        { DISPLAY_ACTIVE, 0x3F, 0x04, false },
+        { DISPLAY_STANDBY, 0x3F, 0x04, false },
+    },
+    [NAV1] = {
+        { DISPLAY_ACTIVE, 0x1F, 0x04, false },
+        { DISPLAY_STANDBY, 0x1F, 0x04, false },
+    },
+    [NAV2] = {
+        { DISPLAY_ACTIVE, 0x1F, 0x04, false },
+        { DISPLAY_STANDBY, 0x1F, 0x04, false },
+    },
+    [DME] = {
+        { DISPLAY_ACTIVE, 0x1F, 0x04, false },
+        { DISPLAY_STANDBY, 0x1F, 0x04, false },
+    },
+    [ADF] = {
+        { DISPLAY_ACTIVE, 0x3F, 0x00, false },
+        { DISPLAY_STANDBY, 0x3F, 0x00, false },
+    },
+    [XPDR] = {
+        { DISPLAY_ACTIVE, 0x3C, 0x00, true },
+        { DISPLAY_OFF, 0x00, 0x00, false },
+    },
+};
+
 int display_handler_init(void) {
 
-    if (tm1638_init(&disp1, DISP_1_SELECT, DISP_DATA, DISP_CLK) != 0) {
+    if (tm1638_init(&disp1, DISP_1_SELECT_PIN_NUM, DISP_DATA, DISP_CLK) != 0) {
         return 1;
     }
 
-    if (tm1638_init(&disp2, DISP_2_SELECT, DISP_DATA, DISP_CLK) != 0) {
+    if (tm1638_init(&disp2, DISP_2_SELECT_PIN_NUM, DISP_DATA, DISP_CLK) != 0) {
         return 2;
     }
 
+    display_device_init(&leftDisplay, &tm1638DisplayOps, &disp2, TM1638_DIGITS);
+    display_device_init(&rightDisplay, &tm1638DisplayOps, &disp1, TM1638_DIGITS);
+    for (uint8_t i = 0; i < NUM_DISPLAYS; i++) {
+        display_device_set_brightness(displays[i], DISPLAY_BRIGHTNESS);
+    }
+
+#ifdef TM1638_BENCHMARK
+    // Prints on the host protocol UART, never enable in a deployed build
+    tm1638_benchmark(&disp1);
+#endif
+
     return 0;
 }
 
+/** 
+ * @brief Render the value shown by a display into a frame
+ * @param layout the layout of the display
+ * @param value the value to show
+ * @param frame the frame to fill
+ * 
+ */
+static void render_display(const struct DisplayLayout* layout, freq_t value, struct DisplayFrame* frame) {
+    uint8_t* segments = frame->segments;
+    tm1638_format_decimal(value, segments, layout->leadingZeros);
+
+    for (uint8_t i = 0; i < TM1638_DIGITS; i++) {
+        if ((layout->dotMask >> i) & 1) {
+            segments[i] |= DOT_SEGMENT;
+        }
+        if (!((layout->digitMask >> i) & 1)) {
+            segments[i] = 0x0;
+        }
+    }
+}
+
+/** 
+ * @brief Render a radio layout to the back buffer of every display that is
+ * on and set which displays are on
+ * @param layouts the NUM_DISPLAYS layouts of the radio
+ * @param active the active frequency
+ * @param standby the standby frequency
+ * 
+ */
+static void render_layout(const struct DisplayLayout layouts[], freq_t active, freq_t standby) {
+    for (uint8_t i = 0; i < NUM_DISPLAYS; i++) {
+        display_device_set_power(displays[i], layouts[i].source != DISPLAY_OFF);
+        if (layouts[i].source == DISPLAY_OFF) {
+            continue;
+        }
+
+        freq_t value = (layouts[i].source == DISPLAY_ACTIVE) ? active : standby;
+        render_display(&layouts[i], value, display_device_back_buffer(displays[i]));
+    }
+}
+
+/** 
+ * @brief Set the effect of each display, the standby digits blink while the
+ * encoders are being turned and the transponder code flashes during ident
+ * @param layouts the layouts being shown
+ * @param deviceType the radio being shown
+ * @param now the uptime in ms
+ * 
+ */
+static void update_effects(const struct DisplayLayout layouts[], freqType_t deviceType, uint32_t now) {
+    uint32_t inputTime = freq_info_get_input_time();
+    bool editing = (inputTime != 0) && (now - inputTime < EDIT_BLINK_MS);
+    bool ident = (deviceType == XPDR) && freq_info_get_ident();
+
+    for (uint8_t i = 0; i < NUM_DISPLAYS; i++) {
+        DisplayEffect_t effect = DISPLAY_EFFECT_NONE;
+
+        if (editing && (layouts[i].source == DISPLAY_STANDBY)) {
+            effect = DISPLAY_EFFECT_BLINK;
+        } else if (ident && (layouts[i].source == DISPLAY_ACTIVE)) {
+            effect = DISPLAY_EFFECT_FLASH;
+        }
+
+        display_device_set_effect(displays[i], effect, layouts[i].digitMask);
+    }
+}
+
 int display_handler_update(void) {
+    static bool displaysReady = false;
     static bool firstRun = true;
+
+    if (!displaysReady) {
+        bool leftReady = display_device_init_update(&leftDisplay);
+        bool rightReady = display_device_init_update(&rightDisplay);
+        displaysReady = leftReady && rightReady;
+
+        if (!displaysReady) {
+            return 0;
+        }
+    }
     
-    static freqType_t prevDeviceType = COM1;
+    static uint8_t prevFreqVersion = 0;
+    static uint8_t prevSelectVersion = 0;
+    static freqType_t deviceType = COM1;
+    static struct DisplayLayout layouts[NUM_DISPLAYS];
+    static bool effectsPending = false;
+    static uint32_t lastFrameTime = 0;
 
-    static freq_t prevActive = 0;
-    static freq_t prevStandby = 0;
+    uint32_t now = uptime_ms();
 
-    freqType_t deviceType = freq_handler_convert_to_type(device_select_get());
+    uint8_t freqVersion = freq_info_get_version();
+    uint8_t selectVersion = device_select_get_version();
+    bool changed = firstRun || (prevFreqVersion != freqVersion) || (prevSelectVersion != selectVersion);
 
-    freq_t active = freq_info_get(deviceType, ACTIVE_FREQ);
-    freq_t standby = freq_info_get(deviceType, STANDBY_FREQ);
+    // The effects only need a commit when their phase changes
+    update_effects(layouts, deviceType, now);
+    effectsPending |= display_device_tick(displays, NUM_DISPLAYS, now);
 
-    if (firstRun) {
-        tm1638_reset(&disp1);
-        tm1638_reset(&disp2);
-        firstRun = false;
+    if (!changed && !effectsPending) {
+        return 0;
     }
 
-    if (prevDeviceType != deviceType) {
-        tm1638_reset(&disp1);
-        tm1638_reset(&disp2);
-        switch (deviceType) {
-            case COM1:
-            case COM2:
-                tm1638_enable_dot(&disp2, 2, true);
-                tm1638_enable_dot(&disp1, 2, true);
-                break;
-            case NAV1:
-            case NAV2:
-                tm1638_enable_dot(&disp2, 2, true);
-                tm1638_enable_dot(&disp1, 2, true);
-                tm1638_enable_digit(&disp2, 5, false);
-                tm1638_enable_digit(&disp1, 5, false);
-                break;
-        
-            case XPDR:
-                tm1638_enable_digit(&disp2, 0, false);
-                tm1638_enable_digit(&disp2, 1, false);
-                tm1638_set_display_state(&disp1, false);
-                break;
-            default:
-                break;
-            }
-
-        prevDeviceType = deviceType;
+    // Changes are left pending until the next frame so fast encoder input
+    // only sends the latest value
+    if (!firstRun && (now - lastFrameTime < DISPLAY_FRAME_MS)) {
+        return 0;
     }
+    lastFrameTime = now;
 
-    if (prevActive != active || prevStandby != standby) {
-        switch (deviceType) {
-        case COM1:
-        case COM2:
-        case NAV1:
-        case NAV2:
-            tm1638_write(&disp2, active, "%d");
-            tm1638_write(&disp1, standby, "%d");
-            break;
-
-        case XPDR:
-            tm1638_write(&disp2, active, "%d");
-        default:
-            break;
-        }
-        prevActive = active;
-        prevStandby = standby;
+    if (changed) {
+        deviceType = freq_handler_convert_to_type(device_select_get());
+
+        freq_t active = freq_info_get(deviceType, ACTIVE_FREQ);
+        freq_t standby = freq_info_get(deviceType, STANDBY_FREQ);
+
+        memcpy_P(layouts, radioLayouts[deviceType], sizeof(layouts));
+
+        render_layout(layouts, active, standby);
+
+        // Apply the effects of the new layout in the same frame
+        update_effects(layouts, deviceType, now);
+        display_device_tick(displays, NUM_DISPLAYS, now);
+
+        firstRun = false;
+        prevFreqVersion = freqVersion;
+        prevSelectVersion = selectVersion;
     }
-    
+
+    // Both displays flip together and only the power states and digits that
+    // differ from what is shown are sent, so a radio change only touches the
+    // attributes it changes
+    display_device_commit(displays, NUM_DISPLAYS);
+    effectsPending = false;
 
     return 0;
-}
\ No newline at end of file
+}
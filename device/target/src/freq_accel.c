@@ -0,0 +1,123 @@
+/**
+ * @file freq_accel.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Implementation of the encoder acceleration
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "avr_extends/uptime.h"
+
+#include "freq_input.h"
+
+#include "freq_accel.h"
+
+#define NUM_ENCODERS 2
+
+// Detents read further apart than this never accelerate. The 16 bit detent
+// times wrap every 65.5 s so they can not measure longer gaps themselves.
+#define ACCEL_IDLE_MS 1000
+
+/// @brief A point on an acceleration curve
+struct AccelStep {
+    uint16_t maxIntervalMs; // Longest time since the previous detent for this step
+    uint8_t multiplier; // Detents counted for each detent turned
+};
+
+// Acceleration curves from fastest to slowest, slower detents count once
+static const struct AccelStep fineCurve[] = {
+    { 25, 10 },
+    { 50, 5 },
+    { 90, 2 },
+};
+
+static const struct AccelStep coarseCurve[] = {
+    { 40, 4 },
+    { 80, 2 },
+};
+
+/// @brief The acceleration state of an encoder
+struct AccelEncoder {
+    const struct AccelStep* curve;
+    uint8_t curveLen;
+    uint16_t lastTime; // Time of the previous detent in ms
+    uint32_t lastUptime; // Uptime the previous detent was read in ms
+    uint8_t lastFlags; // Flags of the previous detent
+    bool lastValid; // True while the previous detent is recent enough to compare with
+    int16_t scaled; // Scaled detents waiting to be read
+};
+
+static struct AccelEncoder encoders[NUM_ENCODERS] = {
+    [FREQ_COURSE_INPUT] = { .curve = coarseCurve, .curveLen = sizeof(coarseCurve) / sizeof(coarseCurve[0]) },
+    [FREQ_FINE_INPUT] = { .curve = fineCurve, .curveLen = sizeof(fineCurve) / sizeof(fineCurve[0]) },
+};
+
+/**
+ * @brief Find the multiplier of a detent from the time since the previous
+ * detent in the same direction
+ * @param encoder the encoder turned
+ * @param event the detent
+ *
+ * @return the detents to count
+ */
+static uint8_t detent_multiplier(struct AccelEncoder* encoder, const struct FreqInputEvent* event) {
+    uint8_t multiplier = 1;
+
+    // Detents are read within a main loop pass of being turned, so the
+    // uptime between reads catches idle gaps the detent times wrap over
+    uint32_t now = uptime_ms();
+    if ((now - encoder->lastUptime) > ACCEL_IDLE_MS) {
+        encoder->lastValid = false;
+    }
+    encoder->lastUptime = now;
+
+    if (encoder->lastValid && (encoder->lastFlags == event->flags)) {
+        uint16_t interval = event->time - encoder->lastTime;
+
+        for (uint8_t i = 0; i < encoder->curveLen; i++) {
+            if (interval <= encoder->curve[i].maxIntervalMs) {
+                multiplier = encoder->curve[i].multiplier;
+                break;
+            }
+        }
+    }
+
+    encoder->lastTime = event->time;
+    encoder->lastFlags = event->flags;
+    encoder->lastValid = true;
+
+    return multiplier;
+}
+
+void freq_accel_add_event(const struct FreqInputEvent* event) {
+    struct AccelEncoder* encoder = &encoders[(event->flags & FREQ_EVENT_COARSE) ? FREQ_COURSE_INPUT : FREQ_FINE_INPUT];
+    int8_t direction = (event->flags & FREQ_EVENT_DECREMENT) ? -1 : 1;
+
+    encoder->scaled += direction * detent_multiplier(encoder, event);
+}
+
+int8_t freq_accel_get(FreqInputSources_t input) {
+    if (input >= NUM_ENCODERS) {
+        return 0;
+    }
+
+    int16_t detents = encoders[input].scaled;
+    if (detents > INT8_MAX) {
+        detents = INT8_MAX;
+    } else if (detents < INT8_MIN) {
+        detents = INT8_MIN;
+    }
+    encoders[input].scaled -= detents;
+
+    return (int8_t)detents;
+}
+
+void freq_accel_clear(void) {
+    for (uint8_t i = 0; i < NUM_ENCODERS; i++) {
+        encoders[i].scaled = 0;
+        encoders[i].lastValid = false;
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file freq_accel.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Velocity based acceleration of the encoder detents, fast turns
+ * are scaled up so the frequency range can be crossed in a few rotations
+ */
+
+
+#ifndef FREQ_ACCEL_H
+#define FREQ_ACCEL_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freq_input.h"
+
+/**
+ * @brief Scale a detent by how fast it followed the previous one, this is
+ * passed to freq_input_snapshot
+ * @param event the detent
+ *
+ */
+void freq_accel_add_event(const struct FreqInputEvent* event);
+
+/**
+ * @brief Get the scaled detents of an encoder since the last call
+ * @param input the encoder to get
+ *
+ * @return the scaled detents, limited to the int8_t range
+ */
+int8_t freq_accel_get(FreqInputSources_t input);
+
+/**
+ * @brief Discard the scaled detents of both encoders, the next detent of
+ * each is not accelerated
+ *
+ */
+void freq_accel_clear(void);
+
+
+#endif // FREQ_ACCEL_H
@@ -12,6 +12,16 @@
 #include "freq_display.h"
 
 #include "TM1637.h"
+#include "TM1638.h"
+#include "display_device.h"
+
+// The TM1638 decimal conversion fills the frames
+#if TM1637_DIGITS != TM1638_DIGITS
+#error "TM1637_DIGITS must match TM1638_DIGITS"
+#endif
+
+#define NUM_DISPLAYS 2
+#define DISPLAY_BRIGHTNESS 5 // The 10/16 pulse width used before the interface
 
 struct TM1637Device activeDisplay = {
     .name = "Active Display"
@@ -21,6 +31,10 @@ struct TM1637Device standbyDisplay = {
     .name = "Standby Display"
 };
 
+// The displays indexed by freqOption_t
+struct DisplayDevice freqDisplays[NUM_DISPLAYS];
+struct DisplayDevice* freqDisplayPtrs[NUM_DISPLAYS] = { &freqDisplays[STANDBY_FREQ], &freqDisplays[ACTIVE_FREQ] };
+
 int freq_display_init(void) {
     activeDisplay.clockPin = PIN(PORTB, 3); // Pin 11
     activeDisplay.dataPin = PIN(PORTB, 2); // Pin 10
@@ -29,27 +43,31 @@ int freq_display_init(void) {
     standbyDisplay.dataPin = PIN(PORTB, 0); // pin 8
 
     int result = 0;
-    result |= tm1637_init(activeDisplay);
-    result |= tm1637_init(standbyDisplay);
+    result |= tm1637_init(&activeDisplay);
+    result |= tm1637_init(&standbyDisplay);
+
+    result |= display_device_init(&freqDisplays[ACTIVE_FREQ], &tm1637DisplayOps, &activeDisplay, TM1637_DIGITS);
+    result |= display_device_init(&freqDisplays[STANDBY_FREQ], &tm1637DisplayOps, &standbyDisplay, TM1637_DIGITS);
+    for (uint8_t i = 0; i < NUM_DISPLAYS; i++) {
+        display_device_set_brightness(&freqDisplays[i], DISPLAY_BRIGHTNESS);
+    }
 
     return result;
 }
 
 int freq_display_write(freqOption_t type, freq_t frequency) {
-    int result = 0;
-    switch (type) {
-    // case ACTIVE_FREQ:
-    //     result = tm1637_write(activeDisplay, frequency);
-    //     break;
-
-    // case STANDBY_FREQ:
-    //     result = tm1637_write(standbyDisplay, frequency);
-    //     break;
-
-    default:
-        result = 1;
-        break;
+    bool activeReady = display_device_init_update(&freqDisplays[ACTIVE_FREQ]);
+    bool standbyReady = display_device_init_update(&freqDisplays[STANDBY_FREQ]);
+    if (!activeReady || !standbyReady) {
+        return 1;
     }
 
-    return result;
-}
\ No newline at end of file
+    if (type >= NUM_DISPLAYS) {
+        return 1;
+    }
+
+    struct DisplayFrame* frame = display_device_back_buffer(&freqDisplays[type]);
+    tm1638_format_decimal(frequency, frame->segments, true);
+
+    return display_device_commit(freqDisplayPtrs, NUM_DISPLAYS);
+}
@@ -27,7 +27,7 @@ int freq_display_init(void);
  * @param type the display to write too
  * @param frequency the frequency to write
  *
- * @return 0 if successful
+ * @return 0 if successful, 1 if the displays are still starting up
  */
 int freq_display_write(freqOption_t type, freq_t frequency);
 
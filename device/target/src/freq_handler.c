@@ -13,6 +13,8 @@
 #include "custom_can_protocol/packet_processing.h"
 #include "custom_can_protocol/packet_handler.h"
 
+#include "freq_input.h"
+#include "freq_accel.h"
 #include "freq_info.h"
 #include "device_select.h"
 
@@ -66,7 +68,14 @@ freqType_t freq_handler_convert_to_type(uint8_t value) {
 bool freq_handler_update(void) {
     freqType_t type = freq_handler_convert_to_type(device_select_get());
 
-    return freq_info_update(type) || freq_info_check_swap(type);
+    // Every input change is read at once so the encoders and button agree
+    struct FreqInputSnapshot input;
+    freq_input_snapshot(&input, freq_accel_add_event);
+
+    bool updated = freq_info_update(type, &input);
+    bool swapped = freq_info_check_swap(type, &input);
+
+    return updated || swapped;
 }
 
 packetProcessingResult_t freq_handler_packet_cb(uint8_t* payload, uint16_t payloadLen) {
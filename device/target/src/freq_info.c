@@ -11,239 +11,290 @@
 
 #include <stdio.h>
 
+#include <avr/pgmspace.h>
+
+#include "avr_extends/uptime.h"
+
 #include "freq_input.h"
+#include "freq_accel.h"
 
 #include "freq_info.h"
 
 #define COM_MINIMUM_FREQ 108000
-#define COM_MAXIMUM_FREQ 137999
+#define COM_MAXIMUM_FREQ 137995
 
 #define NAV_MINIMUM_FREQ 108000
 #define NAV_MAXIMUM_FREQ 117950
 
-#define MAX_XPDR_VALUE 7777
+#define ADF_MINIMUM_FREQ 190
+#define ADF_MAXIMUM_FREQ 1799
+
+#define XPDR_CODES 4096 // Four octal digits
+#define XPDR_DIGITS 4
 
 #define MHz_STEP 1
 #define KHz_STEP 5
 #define NAV_KHz_STEP 50
+#define ADF_KHz_STEP 1
+#define ADF_COARSE_KHz 100 // The coarse encoder moves the hundreds digit
 
 #define MHz_OFFSET 1000
-#define KHz_OFFSET 1
 
-freq_t com1ActiveFreq = 118000;
-freq_t com1StandbyFreq = 118000;
-freq_t com2ActiveFreq = 118000;
-freq_t com2StandbyFreq = 118000;
+// The channels from min to max with step kHz between them
+#define NUM_CHANNELS(min, max, step) (((max) - (min)) / (step) + 1)
+#define FREQ_TO_CHANNEL(freq, min, step) (((freq) - (min)) / (step))
+
+#define IDENT_DURATION_MS 18000 // Time the transponder squawks ident for
+
+/// @brief How a radio wraps when it is tuned past its limits
+typedef enum RadioWrap_e {
+    RADIO_WRAP_RANGE, // The standby frequency wraps around the range
+    RADIO_WRAP_OCTAL, // The active value is an octal code with no standby
+} RadioWrap_t;
 
-freq_t nav1ActiveFreq = 118000;
-freq_t nav1StandbyFreq = 118000;
-freq_t nav2ActiveFreq = 118000;
-freq_t nav2StandbyFreq = 118000;
+/// @brief The fixed tuning limits of a radio. Its values are stored as a
+/// channel index, the frequency of a channel is min + channel * channelStep.
+struct RadioLimits {
+    freq_t min; // The frequency of channel 0
+    uint16_t channelStep; // kHz between channels
+    uint16_t numChannels; // The channel index wraps at this
+    uint16_t fineStep; // Channels moved by one fine detent
+    uint16_t coarseStep; // Channels moved by one coarse detent
+    uint8_t wrap; // The RadioWrap_t
+};
 
-freq_t adf1ActiveFreq = 118000;
-freq_t adf1StandbyFreq = 118000;
+/// @brief The channels of a radio
+struct Radio {
+    uint16_t active;
+    uint16_t standby;
+};
 
-freq_t dme1ActiveFreq = 118000;
-freq_t dme1StandbyFreq = 118000;
+// The limits of each radio, indexed by freqType_t
+static const struct RadioLimits radioLimits[NUM_FREQ_TYPES] PROGMEM = {
+    [COM1] = { COM_MINIMUM_FREQ, KHz_STEP, NUM_CHANNELS(COM_MINIMUM_FREQ, COM_MAXIMUM_FREQ, KHz_STEP),
+        1, MHz_STEP * MHz_OFFSET / KHz_STEP, RADIO_WRAP_RANGE },
+    [COM2] = { COM_MINIMUM_FREQ, KHz_STEP, NUM_CHANNELS(COM_MINIMUM_FREQ, COM_MAXIMUM_FREQ, KHz_STEP),
+        1, MHz_STEP * MHz_OFFSET / KHz_STEP, RADIO_WRAP_RANGE },
+    [NAV1] = { NAV_MINIMUM_FREQ, NAV_KHz_STEP, NUM_CHANNELS(NAV_MINIMUM_FREQ, NAV_MAXIMUM_FREQ, NAV_KHz_STEP),
+        1, MHz_STEP * MHz_OFFSET / NAV_KHz_STEP, RADIO_WRAP_RANGE },
+    [NAV2] = { NAV_MINIMUM_FREQ, NAV_KHz_STEP, NUM_CHANNELS(NAV_MINIMUM_FREQ, NAV_MAXIMUM_FREQ, NAV_KHz_STEP),
+        1, MHz_STEP * MHz_OFFSET / NAV_KHz_STEP, RADIO_WRAP_RANGE },
+    [DME] = { NAV_MINIMUM_FREQ, NAV_KHz_STEP, NUM_CHANNELS(NAV_MINIMUM_FREQ, NAV_MAXIMUM_FREQ, NAV_KHz_STEP),
+        1, MHz_STEP * MHz_OFFSET / NAV_KHz_STEP, RADIO_WRAP_RANGE }, // DME channels follow the VHF NAV channels
+    [ADF] = { ADF_MINIMUM_FREQ, ADF_KHz_STEP, NUM_CHANNELS(ADF_MINIMUM_FREQ, ADF_MAXIMUM_FREQ, ADF_KHz_STEP),
+        1, ADF_COARSE_KHz / ADF_KHz_STEP, RADIO_WRAP_RANGE },
+    [XPDR] = { 0, 1, XPDR_CODES, 1, 8 * 8, RADIO_WRAP_OCTAL }, // Coarse moves the second digit
+};
 
-freq_t xpdrValue = 7000;
+// The channels of each radio, indexed by freqType_t
+struct Radio radios[NUM_FREQ_TYPES] = {
+    [COM1] = { FREQ_TO_CHANNEL(118000, COM_MINIMUM_FREQ, KHz_STEP), FREQ_TO_CHANNEL(118000, COM_MINIMUM_FREQ, KHz_STEP) },
+    [COM2] = { FREQ_TO_CHANNEL(118000, COM_MINIMUM_FREQ, KHz_STEP), FREQ_TO_CHANNEL(118000, COM_MINIMUM_FREQ, KHz_STEP) },
+    [NAV1] = { FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP), FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP) },
+    [NAV2] = { FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP), FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP) },
+    [DME] = { FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP), FREQ_TO_CHANNEL(108000, NAV_MINIMUM_FREQ, NAV_KHz_STEP) },
+    [ADF] = { FREQ_TO_CHANNEL(190, ADF_MINIMUM_FREQ, ADF_KHz_STEP), FREQ_TO_CHANNEL(190, ADF_MINIMUM_FREQ, ADF_KHz_STEP) },
+    [XPDR] = { 07000, 0 }, // Squawk 7000
+};
+
+static uint8_t freqVersion = 0; // Incremented whenever a frequency changes
+static uint32_t inputTime = 0; // Uptime of the last encoder change in ms
+static bool identActive = false;
+static uint32_t identStartTime = 0; // Uptime the ident was started in ms
 
 /** 
- * @brief update a spesific frequency value
- * @param 
+ * @brief Move a channel by the detents of the encoders, wrapping around the
+ * channels of the radio
+ * @param channel the channel to update
+ * @param fineAdjust the fine detents to add
+ * @param coarseAdjust the coarse detents to add
+ * @param limits the limits of the radio
  * 
- * @return 
  */
-void update_freq_value(freq_t* freq, int8_t fineAdjust, int8_t coarseAdjust, freq_t maxFreq, freq_t minFreq, uint32_t khz_step) {
-    freq_t temp = *freq + (coarseAdjust * MHz_STEP) * MHz_OFFSET
-                    + (fineAdjust * khz_step) * KHz_OFFSET;
-    
-    if (temp > maxFreq) {
-        temp = minFreq + (temp - maxFreq - khz_step);
-    } else if (temp < minFreq) {
-        temp = maxFreq - (minFreq - temp - khz_step);
+static void update_channel(uint16_t* channel, int8_t fineAdjust, int8_t coarseAdjust,
+    const struct RadioLimits* limits) {
+    int16_t numChannels = limits->numChannels;
+    int16_t delta = fineAdjust * (int16_t)limits->fineStep + coarseAdjust * (int16_t)limits->coarseStep;
+
+    if ((delta >= numChannels) || (delta <= -numChannels)) {
+        delta %= numChannels;
     }
-    
-    *freq = temp;    
-}  
 
-int freq_info_init(void) {
-    int result = freq_input_init();
+    uint16_t temp = *channel + ((delta < 0) ? delta + numChannels : delta);
+    if (temp >= limits->numChannels) {
+        temp -= limits->numChannels;
+    }
 
-    return result;
+    *channel = temp;
 }
 
-freq_t freq_info_get(freqType_t freqType, freqOption_t freqOption) {
-    if (freqOption == ACTIVE_FREQ) {
-        switch (freqType) {
-        case COM1: return com1ActiveFreq;
-        case COM2: return com2ActiveFreq;
-        case NAV1: return nav1ActiveFreq;
-        case NAV2: return nav2ActiveFreq;
-        case XPDR: return xpdrValue;
-        default:
-            break;
-        }
-    } else if (freqOption == STANDBY_FREQ) {
-        switch (freqType) {
-        case COM1: return com1StandbyFreq;
-        case COM2: return com2StandbyFreq;
-        case NAV1: return nav1StandbyFreq;
-        case NAV2: return nav2StandbyFreq;
-        default:
-            break;
+/** 
+ * @brief Convert a channel to the value the host and displays use
+ * @param channel the channel to convert
+ * @param limits the limits of the radio
+ * 
+ * @return the frequency in kHz, or the transponder code with one decimal
+ * digit per octal digit
+ */
+static freq_t channel_to_freq(uint16_t channel, const struct RadioLimits* limits) {
+    if (limits->wrap == RADIO_WRAP_OCTAL) {
+        freq_t code = 0;
+        freq_t place = 1;
+        for (uint8_t i = 0; i < XPDR_DIGITS; i++) {
+            code += (channel & 0x7) * place;
+            channel >>= 3;
+            place *= 10;
         }
+
+        return code;
     }
 
-    return 0;
+    return limits->min + (freq_t)channel * limits->channelStep;
 }
 
-uint32_t increment_octal(uint32_t octal, uint32_t increment, uint32_t second_msd_increment) {
-    uint32_t decimal = 0, power = 1, temp = octal;
-    
-    // Convert octal to decimal
-    while (temp > 0) {
-        decimal += (temp % 10) * power;
-        temp /= 10;
-        power *= 8;
+/** 
+ * @brief Convert a value from the host to the nearest channel
+ * @param freq the frequency in kHz, or the transponder code with one decimal
+ * digit per octal digit
+ * @param limits the limits of the radio
+ * 
+ * @return the channel, limited to the channels of the radio
+ */
+static uint16_t freq_to_channel(freq_t freq, const struct RadioLimits* limits) {
+    if (limits->wrap == RADIO_WRAP_OCTAL) {
+        uint16_t channel = 0;
+        for (uint8_t i = 0; i < XPDR_DIGITS; i++) {
+            uint8_t digit = freq % 10;
+            channel |= ((digit > 7) ? 7 : digit) << (3 * i);
+            freq /= 10;
+        }
+
+        return channel;
     }
-    
-    // Increment in decimal
-    decimal += increment;
-    
-    // Convert back to octal
-    uint32_t new_octal = 0, place = 1;
-    while (decimal > 0) {
-        new_octal += (decimal % 8) * place;
-        decimal /= 8;
-        place *= 10;
+
+    if (freq < limits->min) {
+        return 0;
     }
-    
-    // Modify the second most significant digit and roll over to first digit if needed
-    uint32_t modified_octal = new_octal;
-    uint32_t divisor = 100; // Target the second most significant digit
-    uint32_t digit = (modified_octal / divisor) % 10;
-    digit += second_msd_increment;
-    
-    if (digit >= 8) { // Roll over to first digit
-        uint32_t first_digit_divisor = 1000; // Assuming a 4-digit octal number
-        uint32_t first_digit = (modified_octal / first_digit_divisor) % 10;
-        first_digit = (first_digit + (digit / 8)) % 8;
-        digit %= 8;
-        modified_octal = (modified_octal % first_digit_divisor) + (first_digit * first_digit_divisor);
+
+    freq_t channel = (freq - limits->min + limits->channelStep / 2) / limits->channelStep;
+
+    if (channel >= limits->numChannels) {
+        channel = limits->numChannels - 1;
     }
-    
-    modified_octal = modified_octal - ((modified_octal / divisor) % 10) * divisor + digit * divisor;
-    
-    return modified_octal;
+
+    return channel;
 }
 
+int freq_info_init(void) {
+    int result = freq_input_init();
+
+    return result;
+}
 
-bool freq_info_update(freqType_t freqType) {
-    int8_t fineAdjust = freq_input_get(FREQ_FINE_INPUT);
-    int8_t coarseAdjust = freq_input_get(FREQ_COURSE_INPUT);
+uint8_t freq_info_get_version(void) {
+    return freqVersion;
+}
+
+uint32_t freq_info_get_input_time(void) {
+    return inputTime;
+}
+
+bool freq_info_get_ident(void) {
+    if (identActive && (uptime_ms() - identStartTime >= IDENT_DURATION_MS)) {
+        identActive = false;
+    }
+
+    return identActive;
+}
+
+freq_t freq_info_get(freqType_t freqType, freqOption_t freqOption) {
+    if (freqType >= NUM_FREQ_TYPES) {
+        return 0;
+    }
+
+    struct RadioLimits limits;
+    memcpy_P(&limits, &radioLimits[freqType], sizeof(limits));
+
+    uint16_t channel = (freqOption == ACTIVE_FREQ) ? radios[freqType].active : radios[freqType].standby;
+
+    return channel_to_freq(channel, &limits);
+}
+
+bool freq_info_update(freqType_t freqType, const struct FreqInputSnapshot* input) {
+    int8_t fineAdjust = freq_accel_get(FREQ_FINE_INPUT);
+    int8_t coarseAdjust = freq_accel_get(FREQ_COURSE_INPUT);
+
+    // Every transponder code is wanted so its input is not accelerated
+    if (freqType == XPDR) {
+        fineAdjust = input->fine;
+        coarseAdjust = input->coarse;
+    }
     
-    uint32_t value;
-    switch (freqType) {
-    case COM1:
-        update_freq_value(&com1StandbyFreq, fineAdjust, coarseAdjust,
-            COM_MAXIMUM_FREQ, COM_MINIMUM_FREQ, KHz_STEP);
-        break;
-    case COM2:
-        update_freq_value(&com2StandbyFreq, fineAdjust, coarseAdjust,
-            COM_MAXIMUM_FREQ, COM_MINIMUM_FREQ, KHz_STEP);
-        break;
-    case NAV1:
-        update_freq_value(&nav1StandbyFreq, fineAdjust, coarseAdjust,
-            NAV_MAXIMUM_FREQ, NAV_MINIMUM_FREQ, NAV_KHz_STEP);
-        break;
-    case NAV2:
-        update_freq_value(&nav2StandbyFreq, fineAdjust, coarseAdjust,
-            NAV_MAXIMUM_FREQ, NAV_MINIMUM_FREQ, NAV_KHz_STEP);
-        break;
-    case XPDR:
-        value = increment_octal((uint32_t)xpdrValue, (uint32_t)fineAdjust, (uint32_t)coarseAdjust);
-        
-        if (value > MAX_XPDR_VALUE) {
-            value -= MAX_XPDR_VALUE;
-            if (value > MAX_XPDR_VALUE) {
-                value = 0;
-            }
-        }
+    struct RadioLimits limits;
+    memcpy_P(&limits, &radioLimits[freqType], sizeof(limits));
 
-        xpdrValue = value;
+    struct Radio* radio = &radios[freqType];
+    if (limits.wrap == RADIO_WRAP_OCTAL) {
+        update_channel(&radio->active, fineAdjust, coarseAdjust, &limits);
+    } else {
+        update_channel(&radio->standby, fineAdjust, coarseAdjust, &limits);
+    }
 
-        break;
-    default:
-        break;
+    bool changed = fineAdjust != 0 || coarseAdjust != 0;
+    if (changed) {
+        freqVersion++;
+        inputTime = uptime_ms();
     }
-    return fineAdjust != 0 || coarseAdjust != 0;
+
+    return changed;
 }
 
 void freq_info_set(freqType_t freqType, freqOption_t freqOption, freq_t freqValue) {
-    // Clear inputs as they were based on an old frequency
-    freq_input_get(FREQ_FINE_INPUT);
-    freq_input_get(FREQ_COURSE_INPUT);
+    // Clear the detents as they were based on an old frequency, button
+    // gestures do not depend on it so they are kept
+    freq_input_clear_detents();
+    freq_accel_clear();
+
+    if (freqType >= NUM_FREQ_TYPES) {
+        return;
+    }
+
+    freqVersion++;
+
+    struct RadioLimits limits;
+    memcpy_P(&limits, &radioLimits[freqType], sizeof(limits));
 
     if (freqOption == ACTIVE_FREQ) {
-        switch (freqType){
-        case COM1: com1ActiveFreq = freqValue; break;
-        case COM2: com2ActiveFreq = freqValue; break;
-        case NAV1: nav1ActiveFreq = freqValue; break;
-        case NAV2: nav2ActiveFreq = freqValue; break;
-        
-        default:
-            break;
-        }
+        radios[freqType].active = freq_to_channel(freqValue, &limits);
     } else if (freqOption == STANDBY_FREQ) {
-        switch (freqType){
-        case COM1: com1StandbyFreq = freqValue; break;
-        case COM2: com2StandbyFreq = freqValue; break;
-        case NAV1: nav1StandbyFreq = freqValue; break;
-        case NAV2: nav2StandbyFreq = freqValue; break;
-        
-        default:
-            break;
-        }
+        radios[freqType].standby = freq_to_channel(freqValue, &limits);
     }
 }
 
-bool freq_info_check_swap(freqType_t freqType) {
-    FreqButtonState_t freqButtonState = freq_input_button_get(FREQ_FINE_INPUT);
-    if (freqButtonState != FREQ_BUTTON_UP_DOWN) {
+bool freq_info_check_swap(freqType_t freqType, const struct FreqInputSnapshot* input) {
+    if (!FREQ_GESTURE(input->fineGestures, FREQ_GESTURE_PRESS)) {
         return false;
     }
 
+    // The transponder has no standby code so the button squawks ident
+    if (freqType == XPDR) {
+        identActive = true;
+        identStartTime = uptime_ms();
+    }
+
     freq_info_swap(freqType);
     return true;
 }
 
 void freq_info_swap(freqType_t freqType) {
-    freq_t temp = 0;
-
-    switch (freqType) {
-        case COM1:
-            temp = com1ActiveFreq;
-            com1ActiveFreq = com1StandbyFreq;
-            com1StandbyFreq = temp;
-            break;
-        case COM2:
-            temp = com2ActiveFreq;
-            com2ActiveFreq = com2StandbyFreq;
-            com2StandbyFreq = temp;
-            break;
-        case NAV1:
-            temp = nav1ActiveFreq;
-            nav1ActiveFreq = nav1StandbyFreq;
-            nav1StandbyFreq = temp;
-            break;
-        case NAV2:
-            temp = nav2ActiveFreq;
-            nav2ActiveFreq = nav2StandbyFreq;
-            nav2StandbyFreq = temp;
-            break;
-    
-    default:
-        break;
+    freqVersion++;
+
+    // An octal code has no standby value to swap with
+    if (pgm_read_byte(&radioLimits[freqType].wrap) == RADIO_WRAP_OCTAL) {
+        return;
     }
-}
\ No newline at end of file
+
+    uint16_t temp = radios[freqType].active;
+    radios[freqType].active = radios[freqType].standby;
+    radios[freqType].standby = temp;
+}
@@ -13,6 +13,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "freq_input.h"
+
 /// @brief The frequency of the radio in kHz
 typedef uint32_t freq_t;
 
@@ -25,6 +27,7 @@ typedef enum PossibleFreqTypes_e {
     DME,
     ADF,
     XPDR,
+    NUM_FREQ_TYPES,
 } freqType_t;
 
 typedef enum PossibleFreqOptions_e {
@@ -39,6 +42,29 @@ typedef enum PossibleFreqOptions_e {
  */
 int freq_info_init(void);
 
+/** 
+ * @brief Get the frequency change counter, this is incremented whenever any
+ * frequency is changed so users can skip work when nothing has changed
+ * 
+ * @return the change counter
+ */
+uint8_t freq_info_get_version(void);
+
+/** 
+ * @brief Get the time the encoders last changed the standby frequency
+ * 
+ * @return the uptime of the last change in ms, 0 if they have not changed it
+ */
+uint32_t freq_info_get_input_time(void);
+
+/** 
+ * @brief Check if the transponder is squawking ident, this is started by
+ * the swap button while the transponder is selected
+ * 
+ * @return true while ident is active
+ */
+bool freq_info_get_ident(void);
+
 /**
  * @brief Get the current frequency
  * @param freqType the frequency to get
@@ -55,17 +81,21 @@ freq_t freq_info_get(freqType_t freqType, freqOption_t freqOption);
 
 
 /** 
- * @brief Update the selected frequency
+ * @brief Update the selected frequency, the encoder detents must already
+ * have been passed to freq_accel by freq_input_snapshot
+ * @param freqType the frequency to update
+ * @param input the input snapshot
  * 
  * @return true if the frequency has changed
  */
-bool freq_info_update(freqType_t freqType);
+bool freq_info_update(freqType_t freqType, const struct FreqInputSnapshot* input);
 
 /**
  * @brief Set a frequency
  * @param freqType the frequency to get
  * @param freqOption the option to get
- * @param freqValue the value to set
+ * @param freqValue the value to set, it is rounded to the nearest channel
+ * of the radio
  *
  */
 void freq_info_set(freqType_t freqType, freqOption_t freqOption, freq_t freqValue);
@@ -73,10 +103,11 @@ void freq_info_set(freqType_t freqType, freqOption_t freqOption, freq_t freqValu
 /**
  * @brief Check to swap the active and standby frequencies
  * @param freqType the frequency to swap if true
+ * @param input the input snapshot
  * 
  * @return true if the frequencies have been swapped
  */
-bool freq_info_check_swap(freqType_t freqType);
+bool freq_info_check_swap(freqType_t freqType, const struct FreqInputSnapshot* input);
 
 /**
  * @brief Swap the active and standby frequencies
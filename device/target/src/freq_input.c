@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 
+#include <avr/io.h>
 #include <avr/interrupt.h>
 
 #include "avr_extends/GPIO.h"
@@ -20,66 +21,209 @@
 
 
 #define STEPS_PER_CLICK 2 // number of encoder steps per division on encoder
+#define EVENT_QUEUE_SIZE 32 // Detents buffered between main loop passes
 
+// Sample the inputs from timer 1 with debouncing instead of using the pin
+// change interrupt, bounce then costs nothing extra
+#ifndef FREQ_INPUT_POLLED
+#define FREQ_INPUT_POLLED 0
+#endif
+#define POLL_RATE_HZ 4000 // Input samples per second
 
-// Storage for changes made to the fine encoder
-static volatile int8_t fineChange = 0;
-static volatile int8_t coarseChange = 0;
-static volatile FreqButtonState_t fineButtonState = FREQ_BUTTON_UP;
+// Timer 1 samples the button every ms and the encoders too when polled
+#define GESTURE_RATE_HZ 1000
+#if FREQ_INPUT_POLLED
+#define INPUT_TIMER_HZ POLL_RATE_HZ
+#else
+#define INPUT_TIMER_HZ GESTURE_RATE_HZ
+#endif
+#define INPUT_TIMER_CS (1 << CS11) // Prescaler of 8
+#define INPUT_TIMER_TOP (F_CPU / 8 / INPUT_TIMER_HZ - 1)
 
-ISR(PCINT2_vect) {
-    static bool fineCHA_prev = false;
-    static bool fineCHB_prev = false;
-    static bool coarseCHA_prev = false;
-    static bool coarseCHB_prev = false;
-    static bool fineButton_prev = !BUTTON_DOWN_VALUE;
-
-    bool fineButton = GPIO_get_state(FINE_BUTTON_PIN);
-
-    if (fineButton != fineButton_prev) {
-        if (fineButtonState == FREQ_BUTTON_UP) {
-            fineButtonState = FREQ_BUTTON_UP_DOWN;
-        } else {
-            fineButtonState = FREQ_BUTTON_DOWN_UP;
-        }
-        fineButton_prev = fineButton;
+#define BUTTON_DEBOUNCE_MS 8 // Net ms a button must be down or up to change
+#define GESTURE_QUEUE_SIZE 8
+
+#define ENCODER_PINS_MASK ((1 << FINE_CHA_PIN_NUM) | (1 << FINE_CHB_PIN_NUM) \
+    | (1 << COARSE_CHA_PIN_NUM) | (1 << COARSE_CHB_PIN_NUM))
+#define INPUT_PINS_MASK (ENCODER_PINS_MASK | (1 << FINE_BUTTON_PIN_NUM))
+
+
+// Quadrature steps indexed by (previous AB << 2) | current AB where A is bit
+// 0. +1 is anti-clockwise, -1 is clockwise and transitions where both
+// channels changed are noise and ignored.
+static const int8_t quadratureTable[16] = {
+     0, +1, -1,  0,
+    -1,  0,  0, +1,
+    +1,  0,  0, -1,
+     0, -1, +1,  0,
+};
+
+// Get the AB state of an encoder from a PIND snapshot
+#define ENCODER_STATE(pins, chaPinNum, chbPinNum) \
+    ((((pins) >> (chaPinNum)) & 1) | ((((pins) >> (chbPinNum)) & 1) << 1))
+
+// Detents waiting for the main loop. The ISR is the only writer of
+// eventHead and the main loop is the only writer of eventTail.
+static volatile struct FreqInputEvent eventQueue[EVENT_QUEUE_SIZE];
+static volatile uint8_t eventHead = 0; // Next free slot
+static volatile uint8_t eventTail = 0; // Oldest event
+static volatile uint8_t eventsDropped = 0; // Detents lost to a full queue
+
+// Fine button FreqGesture_t waiting for the main loop
+static volatile uint8_t gestureQueue[GESTURE_QUEUE_SIZE];
+static volatile uint8_t gestureHead = 0; // Next free slot, written by the ISR
+static volatile uint8_t gestureTail = 0; // Oldest gesture, written by the main loop
+
+// The fine button debounce, only used by the ISR
+static uint8_t buttonIntegrator = 0; // Net ms down, 0 to BUTTON_DEBOUNCE_MS
+static bool buttonDown = false; // The debounced state
+
+// Ms counted by the gesture tick of timer 1 and used to time the detents.
+// Only the ISRs touch it and they do not nest, so stamping a detent is a
+// 16 bit load instead of an uptime_ms() call.
+static volatile uint16_t inputTicks = 0;
+
+// The AB state of each encoder at the last interrupt
+static uint8_t fineState = 0;
+static uint8_t coarseState = 0;
+
+#if FREQ_INPUT_POLLED
+static uint8_t debouncedPins = 0; // PIND with each input pin debounced
+#endif
+
+// Steps within the current detent of each encoder, only used by the ISR
+static int8_t fineSteps = 0;
+static int8_t coarseSteps = 0;
+
+// Detents taken from the queue beyond the int8_t range of a snapshot
+static int16_t fineDetents = 0;
+static int16_t coarseDetents = 0;
+
+/** 
+ * @brief Add a step to an encoder and queue a detent once a full division
+ * has been turned. Called from the ISR only.
+ * @param steps the steps within the current detent of the encoder
+ * @param step the step decoded by the transition table
+ * @param source the FREQ_EVENT_COARSE flag of the encoder
+ * 
+ */
+static inline void add_step(int8_t* steps, int8_t step, uint8_t source) {
+    // A step of 0 is not tested for, the steps are reset at every detent so
+    // adding 0 can never reach one
+    *steps += step;
+    if ((*steps != STEPS_PER_CLICK) && (*steps != -STEPS_PER_CLICK)) {
         return;
     }
 
-    bool fineCHA = GPIO_get_state(FINE_CHA_PIN);
-    bool fineCHB = GPIO_get_state(FINE_CHB_PIN);
-
-    if ((fineCHA != fineCHA_prev) || (fineCHB != fineCHB_prev)) {
-        if (fineCHB != fineCHB_prev) {
-            if (fineCHA == fineCHB_prev) fineChange--; // B leads A so clockwise
-            else fineChange++; // A leads B so anti-clockwise
-            fineCHB_prev = fineCHB;
-        } else if (fineCHA != fineCHA_prev) {
-            if (fineCHB == fineCHA_prev) fineChange++; // A leads B so anti-clockwise
-            else fineChange--; // B leads A so clockwise
-            fineCHA_prev = fineCHA;
-        }
+    uint8_t flags = source | ((*steps < 0) ? FREQ_EVENT_DECREMENT : 0);
+    *steps = 0;
+
+    uint8_t head = eventHead; // Only written here so it is read once
+    uint8_t next = (head + 1 == EVENT_QUEUE_SIZE) ? 0 : head + 1;
+    if (next == eventTail) {
+        eventsDropped++;
         return;
     }
 
-    bool coarseCHA = GPIO_get_state(COARSE_CHA_PIN);
-    bool coarseCHB = GPIO_get_state(COARSE_CHB_PIN);
-
-    if ((coarseCHA != coarseCHA_prev) || (coarseCHB != coarseCHB_prev)) {
-        if (coarseCHB != coarseCHB_prev) {
-            if (coarseCHA == coarseCHB_prev) coarseChange--; // B leads A so clockwise
-            else coarseChange++; // A leads B so anti-clockwise
-            coarseCHB_prev = coarseCHB;
-        } else if (coarseCHA != coarseCHA_prev) {
-            if (coarseCHB == coarseCHA_prev) coarseChange++; // A leads B so anti-clockwise
-            else coarseChange--; // B leads A so clockwise
-            coarseCHA_prev = coarseCHA;
-        }
+    volatile struct FreqInputEvent* event = &eventQueue[head];
+    event->flags = flags;
+    event->time = inputTicks;
+    eventHead = next;
+}
+
+/** 
+ * @brief Decode both encoders from a snapshot of PIND
+ * @param pins the PIND snapshot
+ * 
+ */
+static inline void decode_pins(uint8_t pins) {
+    uint8_t fine = ENCODER_STATE(pins, FINE_CHA_PIN_NUM, FINE_CHB_PIN_NUM);
+    add_step(&fineSteps, quadratureTable[(fineState << 2) | fine], 0);
+    fineState = fine;
+
+    uint8_t coarse = ENCODER_STATE(pins, COARSE_CHA_PIN_NUM, COARSE_CHB_PIN_NUM);
+    add_step(&coarseSteps, quadratureTable[(coarseState << 2) | coarse], FREQ_EVENT_COARSE);
+    coarseState = coarse;
+}
+
+/** 
+ * @brief Queue a gesture of the fine button, it is dropped if the queue is
+ * full. Called from the ISR only.
+ * @param gesture the gesture
+ * 
+ */
+static void queue_gesture(FreqGesture_t gesture) {
+    uint8_t next = (gestureHead + 1 == GESTURE_QUEUE_SIZE) ? 0 : gestureHead + 1;
+    if (next == gestureTail) {
         return;
     }
 
+    gestureQueue[gestureHead] = gesture;
+    gestureHead = next;
 }
 
+/** 
+ * @brief Debounce the fine button by one ms and queue a press once it has
+ * been down for a net BUTTON_DEBOUNCE_MS
+ * @param rawDown true if the button pin reads down
+ * 
+ */
+static void gesture_tick(bool rawDown) {
+    if (rawDown && (buttonIntegrator < BUTTON_DEBOUNCE_MS)) {
+        buttonIntegrator++;
+    } else if (!rawDown && (buttonIntegrator > 0)) {
+        buttonIntegrator--;
+    }
+
+    if (!buttonDown && (buttonIntegrator == BUTTON_DEBOUNCE_MS)) {
+        buttonDown = true;
+        queue_gesture(FREQ_GESTURE_PRESS);
+    } else if (buttonDown && (buttonIntegrator == 0)) {
+        buttonDown = false;
+    }
+}
+
+ISR(TIMER1_COMPA_vect) {
+#if FREQ_INPUT_POLLED
+    // Two bit vertical counters, a pin must read differently for four
+    // samples in a row before its debounced state changes
+    static uint8_t count0 = 0;
+    static uint8_t count1 = 0;
+    static uint8_t gestureDivider = 0;
+
+    uint8_t delta = (PIND ^ debouncedPins) & INPUT_PINS_MASK;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+
+    uint8_t toggle = delta & ~(count0 | count1);
+    if (toggle != 0) {
+        debouncedPins ^= toggle;
+        decode_pins(debouncedPins);
+    }
+
+    if (++gestureDivider < INPUT_TIMER_HZ / GESTURE_RATE_HZ) {
+        return;
+    }
+    gestureDivider = 0;
+
+    uint8_t pins = debouncedPins;
+#else
+    uint8_t pins = PIND;
+#endif
+
+    inputTicks++;
+    gesture_tick(((pins >> FINE_BUTTON_PIN_NUM) & 1) == BUTTON_DOWN_VALUE);
+}
+
+#if !FREQ_INPUT_POLLED
+// Estimated from instruction counts, the table decode takes about 100 cycles
+// where the GPIO_get_state branches it replaced took about 260. Confirm with
+// tests/isr_budget on the avr-gcc build.
+ISR(PCINT2_vect) {
+    decode_pins(PIND);
+}
+#endif
+
 int freq_input_init(void) {
     GPIO_pin_init(FINE_BUTTON_PIN, INPUT_PULLUP);
     GPIO_pin_init(FINE_CHA_PIN, INPUT_PULLUP);
@@ -89,59 +233,95 @@ int freq_input_init(void) {
     GPIO_pin_init(COARSE_CHA_PIN, INPUT_PULLUP);
     GPIO_pin_init(COARSE_CHB_PIN, INPUT_PULLUP);
 
-    // Enable interrupts
-    PCMSK2 |= (1 << FINE_CHA_PIN_NUM) | (1 << FINE_CHB_PIN_NUM)
-        | (1 << FINE_BUTTON_PIN_NUM) | (1 << COARSE_CHA_PIN_NUM)
-        | (1 << COARSE_CHB_PIN_NUM) | (1 << COARSE_BUTTON_PIN_NUM);
+    uint8_t pins = PIND;
+    fineState = ENCODER_STATE(pins, FINE_CHA_PIN_NUM, FINE_CHB_PIN_NUM);
+    coarseState = ENCODER_STATE(pins, COARSE_CHA_PIN_NUM, COARSE_CHB_PIN_NUM);
+
+#if FREQ_INPUT_POLLED
+    debouncedPins = pins;
+    PCICR &= ~(1 << PCIE2); // The pins are sampled instead
+#else
+    // Enable interrupts, the button is sampled by the timer
+    PCMSK2 |= ENCODER_PINS_MASK;
 
     PCICR |= (1 << PCIE2); // Enable the PCINT23..16 pin interrupt
+#endif
+
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | INPUT_TIMER_CS; // CTC mode
+    OCR1A = INPUT_TIMER_TOP;
+    TIMSK1 |= (1 << OCIE1A);
 
     return 0;
 }
 
-int8_t freq_input_get(FreqInputSources_t input) {
-    int8_t returnVal = 0;
-    volatile int8_t* change = &fineChange;
-
-    if (input == FREQ_FINE_INPUT) {
-        returnVal = fineChange;
-        change = &fineChange;
-    } else if (input == FREQ_COURSE_INPUT) {
-        returnVal = coarseChange;
-        change = &coarseChange;
-    } else {
-        return 0;
-    }
+void freq_input_clear_detents(void) {
+    // Only eventTail is written so the ISR can keep queueing
+    eventTail = eventHead;
+    fineDetents = 0;
+    coarseDetents = 0;
+}
+
+uint8_t freq_input_events_dropped(void) {
+    return eventsDropped;
+}
+
+/** 
+ * @brief Limit a detent count to an int8_t, the rest is left in the count
+ * @param count the count to take from
+ * 
+ * @return the detents taken
+ */
+static int8_t take_detents(int16_t* count) {
+    int16_t detents = *count;
 
-    if ((returnVal % 2) == 1) {
-        returnVal = (returnVal + 1) / STEPS_PER_CLICK;
-        *change = -1;
-    } else if ((returnVal % 2) == -1) {
-        returnVal = (returnVal - 1) / STEPS_PER_CLICK;
-        *change = 1;
-    } else {
-        returnVal = returnVal / STEPS_PER_CLICK;
-        *change = 0;
+    if (detents > INT8_MAX) {
+        detents = INT8_MAX;
+    } else if (detents < INT8_MIN) {
+        detents = INT8_MIN;
     }
+    *count -= detents;
 
-    return returnVal;
+    return (int8_t)detents;
 }
 
-FreqButtonState_t freq_input_button_get(FreqInputSources_t button) {
-    volatile FreqButtonState_t* state = &fineButtonState;
+void freq_input_snapshot(struct FreqInputSnapshot* snapshot, FreqInputEventCallback_t eventCallback) {
+    // Both queue heads are read together with interrupts off so the
+    // gestures and detents cover the same moment
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t head = eventHead;
+    uint8_t gestureEnd = gestureHead;
+    SREG = sreg;
 
-    if (button == FREQ_FINE_INPUT) {
-        state = &fineButtonState;
+    snapshot->fineGestures = 0;
+
+    uint8_t gestureIndex = gestureTail;
+    while (gestureIndex != gestureEnd) {
+        snapshot->fineGestures |= 1 << gestureQueue[gestureIndex];
+        gestureIndex = (gestureIndex + 1 == GESTURE_QUEUE_SIZE) ? 0 : gestureIndex + 1;
     }
+    gestureTail = gestureIndex;
 
-    cli();
-    if (*state == FREQ_BUTTON_UP_DOWN) {
-        *state = FREQ_BUTTON_DOWN;
-        return FREQ_BUTTON_UP_DOWN;
-    } else if (*state == FREQ_BUTTON_DOWN_UP) {
-        *state = FREQ_BUTTON_UP;
-        return FREQ_BUTTON_DOWN_UP;
+    // Events up to head were queued before the snapshot and the ISR never
+    // writes to them again until eventTail passes them
+    uint8_t tail = eventTail;
+    while (tail != head) {
+        struct FreqInputEvent event = {
+            .flags = eventQueue[tail].flags,
+            .time = eventQueue[tail].time,
+        };
+        tail = (tail + 1 == EVENT_QUEUE_SIZE) ? 0 : tail + 1;
+
+        int16_t* detents = (event.flags & FREQ_EVENT_COARSE) ? &coarseDetents : &fineDetents;
+        *detents += (event.flags & FREQ_EVENT_DECREMENT) ? -1 : 1;
+
+        if (eventCallback != NULL) {
+            eventCallback(&event);
+        }
     }
-    sei();
-    return *state;
-}
\ No newline at end of file
+    eventTail = tail;
+
+    snapshot->fine = take_detents(&fineDetents);
+    snapshot->coarse = take_detents(&coarseDetents);
+}
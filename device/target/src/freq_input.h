@@ -19,12 +19,34 @@ typedef enum FreqInputSource_e {
     FREQ_FINE_INPUT
 } FreqInputSources_t;
 
-typedef enum FreqButtonState_e {
-    FREQ_BUTTON_UP,
-    FREQ_BUTTON_DOWN,
-    FREQ_BUTTON_UP_DOWN, // Transition from up to down
-    FREQ_BUTTON_DOWN_UP, // Transition from down to up
-} FreqButtonState_t;
+#define FREQ_NUM_INPUTS 2
+
+#define FREQ_EVENT_COARSE (1 << 0) // Set for the coarse encoder, clear for the fine
+#define FREQ_EVENT_DECREMENT (1 << 1) // Set if the encoder was turned down
+
+/// @brief One detent of an encoder
+struct FreqInputEvent {
+    uint8_t flags; // FREQ_EVENT_COARSE and FREQ_EVENT_DECREMENT
+    uint16_t time; // Input timer ms count at the detent, wraps every 65s
+};
+
+/// @brief The debounced gestures of the fine encoder button
+typedef enum FreqGesture_e {
+    FREQ_GESTURE_PRESS,
+} FreqGesture_t;
+
+// Check a gesture bit mask of a snapshot
+#define FREQ_GESTURE(gestures, gesture) (((gestures) >> (gesture)) & 1)
+
+/// @brief The input changes since the previous snapshot
+struct FreqInputSnapshot {
+    int8_t fine; // Detents turned on the fine encoder
+    int8_t coarse; // Detents turned on the coarse encoder
+    uint8_t fineGestures; // Bit mask of the FreqGesture_t of the fine button
+};
+
+/// @brief Called with each detent as a snapshot is taken
+typedef void (*FreqInputEventCallback_t)(const struct FreqInputEvent* event);
 
 /**
  * @brief Initialise the frequency counting module and setup the required inputs
@@ -33,21 +55,30 @@ typedef enum FreqButtonState_e {
  */
 int freq_input_init(void);
 
-/**
- * @brief Get an encoder value
- * @param input the frequency input to return
- *
- * @return The number of steps rotated since last call
+/** 
+ * @brief Capture and clear every encoder detent and button gesture since
+ * the previous snapshot. Interrupts are only disabled to read the event
+ * queue heads and are restored to their previous state.
+ * @param snapshot the snapshot to fill
+ * @param eventCallback called with each detent in order for users of the
+ * detent timing, may be NULL
+ * 
  */
-int8_t freq_input_get(FreqInputSources_t input);
+void freq_input_snapshot(struct FreqInputSnapshot* snapshot, FreqInputEventCallback_t eventCallback);
 
-/**
- * @brief Get the current state of a frequency button
- * @param button the button to get the value of
- *
- * @return the state of the button
+/** 
+ * @brief Discard every encoder detent since the previous snapshot, the
+ * button gestures are kept for the next snapshot
+ * 
+ */
+void freq_input_clear_detents(void);
+
+/** 
+ * @brief Get the number of detents lost because the event queue was full
+ * 
+ * @return the dropped detent count, wraps at 256
  */
-FreqButtonState_t freq_input_button_get(FreqInputSources_t button);
+uint8_t freq_input_events_dropped(void);
 
 
 #endif // FREQ_INPUT_H
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include "display_handler.h"
 #include "freq_handler.h"
+#include "freq_input.h"
 #include "device_select.h"
 
 bool debug = true;
@@ -86,6 +87,7 @@ int main(void) {
     sei();
     uint64_t lastFreqUpdate = uptime_ms();
     uint64_t lastDeviceUpdate = uptime_ms();
+    uint8_t lastEventsDropped = 0;
     while (true) {
         if (freq_handler_update()) {
             uint8_t payloadBuf[10] = { 0 };
@@ -114,6 +116,13 @@ int main(void) {
         }
 
         display_handler_update();
+
+        // Detents are only lost if the loop stalls long enough to fill the queue
+        uint8_t eventsDropped = freq_input_events_dropped();
+        if (debug && (eventsDropped != lastEventsDropped)) {
+            printf("Encoder detents dropped: %u\n", eventsDropped);
+            lastEventsDropped = eventsDropped;
+        }
     }
 
     return 0;
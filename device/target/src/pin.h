@@ -40,10 +40,25 @@
 #define DEVICE_SELECT_2_PIN PIN(PORTB, 2)
 
 // Display pins
-#define DISP_2_SELECT PIN(PORTC, 0)
-#define DISP_1_SELECT PIN(PORTC, 1)
-#define DISP_CLK PIN(PORTC, 2)
-#define DISP_DATA PIN(PORTC, 3)
+#define DISP_PORT PORTC
+#define DISP_DDR DDRC
+#define DISP_PORT_IN PINC
+
+#define DISP_2_SELECT_PIN_NUM 0
+#define DISP_1_SELECT_PIN_NUM 1
+#define DISP_CLK_PIN_NUM 2
+#define DISP_DATA_PIN_NUM 3
+
+// A pin on DISP_PORT from its pin number
+#define DISP_PIN(pinNum) PIN(PORTC, pinNum)
+
+#define DISP_CLK DISP_PIN(DISP_CLK_PIN_NUM)
+#define DISP_DATA DISP_PIN(DISP_DATA_PIN_NUM)
+
+// Every TM1638 display stb pin on DISP_PORT, X(pin number)
+#define DISP_STB_PINS(X) \
+    X(DISP_2_SELECT_PIN_NUM) \
+    X(DISP_1_SELECT_PIN_NUM)
 
 
 #endif // PIN_H
\ No newline at end of file
@@ -0,0 +1,445 @@
+/**
+ * @file isr_budget.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-05
+ * @brief Run the firmware in simavr, drive a scripted waveform into its pins
+ * and measure the cycles every interrupt takes from vectoring to reti. Fails
+ * if any interrupt, or the interrupts together within one UART byte time, go
+ * over their budget.
+ *
+ * Usage: isr_budget <firmware.elf> <script> [NAME=cycles ...]
+ *
+ * A script is one command per line, # starts a comment:
+ *  pin D6 0      drive port D pin 6 low
+ *  wait 250      run the firmware for 250us
+ *  repeat 100    run the lines up to the matching end 100 times
+ *  end
+ *  budget PCINT2=300  set a budget for this script, NAME=cycles arguments override it
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "avr_ioport.h"
+
+
+#define MCU_NAME "atmega328p"
+#define MCU_FREQUENCY 16000000UL
+#define CYCLES_PER_US (MCU_FREQUENCY / 1000000UL)
+
+#define UART_BAUD 115200UL
+#define UART_BYTE_CYCLES (MCU_FREQUENCY * 10 / UART_BAUD) // Start, 8 data and stop bits
+
+#define NUM_VECTORS 26 // Vectors of the atmega328p including reset
+#define WINDOW_HISTORY 64 // Most recent interrupts kept to sum a byte time
+#define MAX_SCRIPT_LINES 1024
+#define MAX_REPEAT_DEPTH 8
+
+#define WINDOW_NAME "WINDOW"
+
+/// @brief The measurements and budget of one interrupt vector
+struct VectorStats {
+    const char* name;
+    uint32_t budget; // Most cycles from vectoring to reti, 0 for no budget
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    avr_cycle_count_t entry; // Cycle the running interrupt was vectored on
+};
+
+/// @brief A finished interrupt, kept to find the busiest byte time
+struct IsrSpan {
+    avr_cycle_count_t start;
+    avr_cycle_count_t end;
+};
+
+typedef enum ScriptOp_e {
+    SCRIPT_PIN,
+    SCRIPT_WAIT,
+    SCRIPT_REPEAT,
+    SCRIPT_END,
+} ScriptOp_t;
+
+struct ScriptLine {
+    ScriptOp_t op;
+    char port;
+    uint8_t pin;
+    uint32_t value; // The level, wait in us or repeat count
+    uint16_t match; // The line of the matching repeat or end
+    uint16_t lineNum;
+};
+
+// Budgets in cycles, the interrupts that are not listed are only reported.
+// These are estimates from the instruction counts of each handler plus about
+// 10%, not avr-gcc measurements. Re-measure them with the avr-gcc
+// ISR_BUDGET_FIRMWARE build and tighten them to the results. TIMER0 and the
+// USART belong to avr_extends, which is built outside this tree, so they are
+// only reported.
+struct VectorStats vectorStats[NUM_VECTORS] = {
+    [1] = { .name = "INT0" },
+    [2] = { .name = "INT1" },
+    [3] = { .name = "PCINT0" },
+    [4] = { .name = "PCINT1" },
+    [5] = { .name = "PCINT2", .budget = 270 }, // Estimated 242 spinning the encoders
+    [6] = { .name = "WDT" },
+    [7] = { .name = "TIMER2_COMPA", .budget = 700 }, // Estimated 638 at the calibrated clock
+    [8] = { .name = "TIMER2_COMPB" },
+    [9] = { .name = "TIMER2_OVF" },
+    [10] = { .name = "TIMER1_CAPT" },
+    [11] = { .name = "TIMER1_COMPA", .budget = 540 }, // Estimated for the FREQ_INPUT_POLLED decode
+    [12] = { .name = "TIMER1_COMPB" },
+    [13] = { .name = "TIMER1_OVF" },
+    [14] = { .name = "TIMER0_COMPA" },
+    [15] = { .name = "TIMER0_COMPB" },
+    [16] = { .name = "TIMER0_OVF" },
+    [17] = { .name = "SPI_STC" },
+    [18] = { .name = "USART_RX" },
+    [19] = { .name = "USART_UDRE" },
+    [20] = { .name = "USART_TX" },
+    [21] = { .name = "ADC" },
+    [22] = { .name = "EE_READY" },
+    [23] = { .name = "ANALOG_COMP" },
+    [24] = { .name = "TWI" },
+    [25] = { .name = "SPM_READY" },
+};
+
+// Most cycles all interrupts may take within one UART byte time, 0 for no
+// budget. The estimated worst case is 1242, a transfer byte, the input and
+// uptime timers and an encoder edge in the same byte time, and the rest of
+// the byte time is left for USART_RX which is last in priority.
+uint32_t windowBudget = 1300;
+uint32_t windowMax = 0;
+
+static avr_t* avr = NULL;
+
+static struct IsrSpan spans[WINDOW_HISTORY];
+static uint8_t spanHead = 0;
+static uint8_t spanCount = 0;
+
+static struct ScriptLine script[MAX_SCRIPT_LINES];
+static uint16_t scriptLength = 0;
+
+/**
+ * @brief Sum the interrupt cycles within one byte time before the end of the
+ * latest interrupt
+ * @param end the cycle the latest interrupt finished on
+ *
+ * @return the cycles spent in interrupts
+ */
+static uint32_t window_busy(avr_cycle_count_t end) {
+    avr_cycle_count_t windowStart = (end > UART_BYTE_CYCLES) ? end - UART_BYTE_CYCLES : 0;
+    uint32_t busy = 0;
+
+    for (uint8_t i = 0; i < spanCount; i++) {
+        const struct IsrSpan* span = &spans[(spanHead + WINDOW_HISTORY - 1 - i) % WINDOW_HISTORY];
+        if (span->end <= windowStart) {
+            break;
+        }
+
+        busy += span->end - ((span->start > windowStart) ? span->start : windowStart);
+    }
+
+    return busy;
+}
+
+/**
+ * @brief Called by simavr when an interrupt is vectored to (value 1) and when
+ * it returns (value 0)
+ * @param irq the running irq of the vector
+ * @param value 1 on entry and 0 on reti
+ * @param param the stats of the vector
+ *
+ */
+static void isr_running_notify(avr_irq_t* irq, uint32_t value, void* param) {
+    (void)irq;
+    struct VectorStats* stats = param;
+
+    if (value) {
+        stats->entry = avr->cycle;
+        return;
+    }
+
+    uint32_t cycles = avr->cycle - stats->entry;
+    stats->count++;
+    stats->total += cycles;
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+
+    spans[spanHead] = (struct IsrSpan) { .start = stats->entry, .end = avr->cycle };
+    spanHead = (spanHead + 1) % WINDOW_HISTORY;
+    if (spanCount < WINDOW_HISTORY) {
+        spanCount++;
+    }
+
+    uint32_t busy = window_busy(avr->cycle);
+    if (busy > windowMax) {
+        windowMax = busy;
+    }
+}
+
+/**
+ * @brief Set the budget of an interrupt from a NAME=cycles argument
+ * @param arg the argument
+ *
+ * @return 0 if successful
+ */
+static int parse_budget(const char* arg) {
+    const char* equals = strchr(arg, '=');
+    if (equals == NULL) {
+        return 1;
+    }
+
+    size_t nameLength = equals - arg;
+    uint32_t budget = strtoul(equals + 1, NULL, 0);
+
+    if ((nameLength == strlen(WINDOW_NAME)) && (strncmp(arg, WINDOW_NAME, nameLength) == 0)) {
+        windowBudget = budget;
+        return 0;
+    }
+
+    for (uint8_t i = 1; i < NUM_VECTORS; i++) {
+        if ((strlen(vectorStats[i].name) == nameLength) && (strncmp(arg, vectorStats[i].name, nameLength) == 0)) {
+            vectorStats[i].budget = budget;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Read a waveform script and match its repeat and end lines
+ * @param path the script file
+ *
+ * @return 0 if successful
+ */
+static int load_script(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open script %s\n", path);
+        return 1;
+    }
+
+    uint16_t repeatStack[MAX_REPEAT_DEPTH];
+    uint8_t depth = 0;
+    char text[128];
+    uint16_t lineNum = 0;
+    int result = 0;
+
+    while ((result == 0) && (fgets(text, sizeof(text), file) != NULL)) {
+        lineNum++;
+
+        char* comment = strchr(text, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char command[16];
+        char arg0[32];
+        char arg1[32];
+        int numArgs = sscanf(text, "%15s %31s %31s", command, arg0, arg1);
+        if (numArgs <= 0) {
+            continue;
+        }
+
+        if (strcmp(command, "budget") == 0) {
+            if ((numArgs != 2) || (parse_budget(arg0) != 0)) {
+                fprintf(stderr, "%s:%u: bad budget\n", path, lineNum);
+                result = 1;
+            }
+            continue;
+        }
+
+        if (scriptLength == MAX_SCRIPT_LINES) {
+            fprintf(stderr, "%s:%u: script too long\n", path, lineNum);
+            result = 1;
+            break;
+        }
+
+        struct ScriptLine* line = &script[scriptLength];
+        line->lineNum = lineNum;
+
+        if ((strcmp(command, "pin") == 0) && (numArgs == 3) && isalpha((unsigned char)arg0[0])) {
+            line->op = SCRIPT_PIN;
+            line->port = toupper((unsigned char)arg0[0]);
+            line->pin = atoi(&arg0[1]);
+            line->value = atoi(arg1) ? 1 : 0;
+        } else if ((strcmp(command, "wait") == 0) && (numArgs == 2)) {
+            line->op = SCRIPT_WAIT;
+            line->value = strtoul(arg0, NULL, 0);
+        } else if ((strcmp(command, "repeat") == 0) && (numArgs == 2) && (depth < MAX_REPEAT_DEPTH)) {
+            line->op = SCRIPT_REPEAT;
+            line->value = strtoul(arg0, NULL, 0);
+            repeatStack[depth++] = scriptLength;
+        } else if ((strcmp(command, "end") == 0) && (depth > 0)) {
+            line->op = SCRIPT_END;
+            line->match = repeatStack[--depth];
+            script[line->match].match = scriptLength;
+        } else {
+            fprintf(stderr, "%s:%u: bad line\n", path, lineNum);
+            result = 1;
+        }
+
+        scriptLength++;
+    }
+
+    if ((result == 0) && (depth != 0)) {
+        fprintf(stderr, "%s: repeat without end\n", path);
+        result = 1;
+    }
+
+    fclose(file);
+    return result;
+}
+
+/**
+ * @brief Run the firmware until a cycle
+ * @param until the cycle to stop on
+ *
+ * @return 0 if successful, 1 if the firmware stopped
+ */
+static int run_until(avr_cycle_count_t until) {
+    while (avr->cycle < until) {
+        int state = avr_run(avr);
+        if ((state == cpu_Done) || (state == cpu_Crashed)) {
+            fprintf(stderr, "Firmware stopped at cycle %llu\n", (unsigned long long)avr->cycle);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Drive the script into the pins of the avr
+ *
+ * @return 0 if successful
+ */
+static int run_script(void) {
+    uint32_t repeatsLeft[MAX_SCRIPT_LINES];
+
+    for (uint16_t i = 0; i < scriptLength; i++) {
+        struct ScriptLine* line = &script[i];
+
+        switch (line->op) {
+        case SCRIPT_PIN: {
+            avr_irq_t* irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(line->port), line->pin);
+            if (irq == NULL) {
+                fprintf(stderr, "Line %u: no pin %c%u\n", line->lineNum, line->port, line->pin);
+                return 1;
+            }
+            avr_raise_irq(irq, line->value);
+            break;
+        }
+
+        case SCRIPT_WAIT:
+            if (run_until(avr->cycle + (avr_cycle_count_t)line->value * CYCLES_PER_US) != 0) {
+                return 1;
+            }
+            break;
+
+        case SCRIPT_REPEAT:
+            repeatsLeft[i] = line->value;
+            if (repeatsLeft[i] == 0) {
+                i = line->match;
+            }
+            break;
+
+        case SCRIPT_END:
+            if (--repeatsLeft[line->match] != 0) {
+                i = line->match;
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the measurements and check them against the budgets
+ *
+ * @return the number of budgets exceeded
+ */
+static int report(void) {
+    int failures = 0;
+
+    printf("%-14s %8s %8s %8s %8s %7s\n", "ISR", "count", "mean", "max", "budget", "%byte");
+    for (uint8_t i = 1; i < NUM_VECTORS; i++) {
+        struct VectorStats* stats = &vectorStats[i];
+        if (stats->count == 0) {
+            continue;
+        }
+
+        bool over = (stats->budget != 0) && (stats->max > stats->budget);
+        failures += over;
+
+        printf("%-14s %8u %8llu %8u %8u %6.1f%%%s\n", stats->name, stats->count,
+            (unsigned long long)(stats->total / stats->count), stats->max, stats->budget,
+            100.0 * stats->max / UART_BYTE_CYCLES, over ? "  OVER BUDGET" : "");
+    }
+
+    bool over = (windowBudget != 0) && (windowMax > windowBudget);
+    failures += over;
+    printf("Most ISR cycles within one %lu cycle byte time: %u, budget %u%s\n",
+        UART_BYTE_CYCLES, windowMax, windowBudget, over ? "  OVER BUDGET" : "");
+
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <firmware.elf> <script> [NAME=cycles ...]\n", argv[0]);
+        return 2;
+    }
+
+    if (load_script(argv[2]) != 0) {
+        return 2;
+    }
+
+    for (int i = 3; i < argc; i++) {
+        if (parse_budget(argv[i]) != 0) {
+            fprintf(stderr, "Bad budget %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    elf_firmware_t firmware = { 0 };
+    if (elf_read_firmware(argv[1], &firmware) != 0) {
+        fprintf(stderr, "Could not read firmware %s\n", argv[1]);
+        return 2;
+    }
+    strcpy(firmware.mmcu, MCU_NAME);
+    firmware.frequency = MCU_FREQUENCY;
+
+    avr = avr_make_mcu_by_name(MCU_NAME);
+    if (avr == NULL) {
+        fprintf(stderr, "simavr does not support %s\n", MCU_NAME);
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+
+    for (uint8_t i = 1; i < NUM_VECTORS; i++) {
+        avr_irq_t* irq = avr_get_interrupt_irq(avr, i);
+        if (irq != NULL) {
+            avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, isr_running_notify, &vectorStats[i]);
+        }
+    }
+
+    if (run_script() != 0) {
+        return 2;
+    }
+
+    return (report() == 0) ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file interrupt.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for avr-libc interrupts, an ISR is an ordinary
+ * function the tests call to run it
+ */
+
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+
+#include "avr/io.h"
+
+#define ISR(vector) void vector(void); void vector(void)
+
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= ~(1 << SREG_I))
+
+
+#endif // INTERRUPT_H
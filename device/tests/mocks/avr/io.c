@@ -0,0 +1,27 @@
+/**
+ * @file io.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in registers for avr/io.h
+ */
+
+
+#include <stdint.h>
+
+#include "avr/io.h"
+
+volatile uint8_t PORTB;
+volatile uint8_t PORTC;
+volatile uint8_t PORTD;
+volatile uint8_t DDRC;
+volatile uint8_t PINC;
+volatile uint8_t PIND;
+
+volatile uint8_t TCCR2A;
+volatile uint8_t TCCR2B;
+volatile uint8_t OCR2A;
+volatile uint8_t TCNT2;
+volatile uint8_t TIMSK2;
+volatile uint8_t TIFR2;
+
+volatile uint8_t SREG;
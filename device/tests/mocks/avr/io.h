@@ -0,0 +1,40 @@
+/**
+ * @file io.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for the avr-libc ATmega328p registers used by the
+ * drivers, the registers are ordinary variables defined in io.c
+ */
+
+
+#ifndef IO_H
+#define IO_H
+
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTB;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t DDRC;
+extern volatile uint8_t PINC;
+extern volatile uint8_t PIND;
+
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t OCR2A;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t TIMSK2;
+extern volatile uint8_t TIFR2;
+
+extern volatile uint8_t SREG;
+
+#define WGM21 1
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+#define OCF2A 1
+#define SREG_I 7
+
+
+#endif // IO_H
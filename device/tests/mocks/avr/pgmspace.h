@@ -0,0 +1,25 @@
+/**
+ * @file pgmspace.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-01
+ * @brief Host stand in for avr-libc program memory access, program memory
+ * is ordinary memory on the host
+ */
+
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define pgm_read_dword(address) (*(const uint32_t*)(address))
+#define memcpy_P memcpy
+
+
+#endif // PGMSPACE_H
@@ -0,0 +1,39 @@
+/**
+ * @file GPIO.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for the avr_extends GPIO module, tests fake the
+ * functions to watch the pins
+ */
+
+
+#ifndef GPIO_H
+#define GPIO_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "avr/io.h"
+
+typedef struct {
+    volatile uint8_t* port;
+    uint8_t num;
+} pin_t;
+
+#define PIN(port, num) ((pin_t){ &(port), (num) })
+
+typedef enum {
+    INPUT_NO_PULLUP,
+    INPUT_PULLUP,
+    OUTPUT,
+} pinMode_t;
+
+void GPIO_pin_init(pin_t pin, pinMode_t mode);
+
+void GPIO_set_output(pin_t pin, bool state);
+
+bool GPIO_get_state(pin_t pin);
+
+
+#endif // GPIO_H
@@ -0,0 +1,20 @@
+/**
+ * @file delay.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for the avr_extends delays, tests fake them
+ */
+
+
+#ifndef AVR_EXTENDS_DELAY_H
+#define AVR_EXTENDS_DELAY_H
+
+
+#include <stdint.h>
+
+void delay_us(uint32_t us);
+
+void delay_ms(uint32_t ms);
+
+
+#endif // AVR_EXTENDS_DELAY_H
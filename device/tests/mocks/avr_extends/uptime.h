@@ -0,0 +1,21 @@
+/**
+ * @file uptime.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-01
+ * @brief Host stand in for the avr_extends uptime module, tests fake
+ * uptime_ms to control time
+ */
+
+
+#ifndef UPTIME_H
+#define UPTIME_H
+
+
+#include <stdint.h>
+
+void uptime_init(void);
+
+uint64_t uptime_ms(void);
+
+
+#endif // UPTIME_H
@@ -0,0 +1,18 @@
+/**
+ * @file delay.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for the avr-libc busy wait delays, they return
+ * straight away
+ */
+
+
+#ifndef DELAY_H
+#define DELAY_H
+
+
+#define _delay_us(us) ((void)(us))
+#define _delay_ms(ms) ((void)(ms))
+
+
+#endif // DELAY_H
@@ -0,0 +1,17 @@
+/**
+ * @file delay_basic.h
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Host stand in for the avr-libc delay loops, they return straight
+ * away
+ */
+
+
+#ifndef DELAY_BASIC_H
+#define DELAY_BASIC_H
+
+
+#define _delay_loop_1(loops) ((void)(loops))
+
+
+#endif // DELAY_BASIC_H
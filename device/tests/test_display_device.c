@@ -0,0 +1,317 @@
+/**
+ * @file test_display_device.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Tests for the common display interface
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+#define FFF_MOCK_IMPL
+
+#include "display_device.h"
+
+#define NUM_DIGITS 6
+
+FAKE_VALUE_FUNC(bool, backend_init_update, void*);
+FAKE_VALUE_FUNC(int, backend_write, void*, const uint8_t*, uint8_t, uint8_t);
+FAKE_VOID_FUNC(backend_flush, void**, uint8_t);
+FAKE_VOID_FUNC(backend_set_brightness, void*, uint8_t);
+FAKE_VOID_FUNC(backend_set_power, void*, bool);
+
+static const struct DisplayDeviceOps fakeOps = {
+    .init_update = backend_init_update,
+    .write = backend_write,
+    .flush = backend_flush,
+    .set_brightness = backend_set_brightness,
+    .set_power = backend_set_power,
+};
+
+// A second backend type to check the flushes are grouped by type
+static const struct DisplayDeviceOps otherOps = {
+    .init_update = backend_init_update,
+    .write = backend_write,
+    .flush = backend_flush,
+    .set_brightness = backend_set_brightness,
+    .set_power = backend_set_power,
+};
+
+static int leftBackend;
+static int rightBackend;
+
+static struct DisplayDevice left;
+static struct DisplayDevice right;
+static struct DisplayDevice* displays[] = { &left, &right };
+
+// The frame handed to the last write
+static uint8_t writtenSegments[DISPLAY_MAX_DIGITS];
+
+static int backend_write_capture(void* backend, const uint8_t segments[], uint8_t start, uint8_t len) {
+    (void)backend;
+    (void)start;
+    (void)len;
+    memcpy(writtenSegments, segments, sizeof(writtenSegments));
+
+    return 0;
+}
+
+/**
+ * @brief Commit the left display on its own
+ *
+ * @return the result of the commit
+ */
+static int commit_left(void) {
+    return display_device_commit(displays, 1);
+}
+
+/**
+ * @brief Fill the left back buffer with a digit per position and commit it
+ * so the front buffer matches
+ *
+ */
+static void show_left_digits(void) {
+    struct DisplayFrame* frame = display_device_back_buffer(&left);
+    for (uint8_t i = 0; i < NUM_DIGITS; i++) {
+        frame->segments[i] = HexTo7Seg[i];
+    }
+
+    commit_left();
+}
+
+/**
+ * @brief Clear the history of every fake, keeping their return values
+ *
+ */
+static void clear_fake_history(void) {
+    backend_write_fake.call_count = 0;
+    backend_flush_fake.call_count = 0;
+    backend_set_brightness_fake.call_count = 0;
+    backend_set_power_fake.call_count = 0;
+    FFF_RESET_HISTORY();
+}
+
+void setUp(void) {
+    RESET_FAKE(backend_init_update);
+    RESET_FAKE(backend_write);
+    RESET_FAKE(backend_flush);
+    RESET_FAKE(backend_set_brightness);
+    RESET_FAKE(backend_set_power);
+    FFF_RESET_HISTORY();
+
+    backend_write_fake.custom_fake = backend_write_capture;
+    memset(writtenSegments, 0, sizeof(writtenSegments));
+
+    display_device_init(&left, &fakeOps, &leftBackend, NUM_DIGITS);
+    display_device_init(&right, &fakeOps, &rightBackend, NUM_DIGITS);
+}
+
+void tearDown(void) {
+
+}
+
+// =========================== Tests ===========================
+void test_display_device_init_rejects_too_many_digits(void) {
+    TEST_ASSERT_EQUAL(1, display_device_init(&left, &fakeOps, &leftBackend, DISPLAY_MAX_DIGITS + 1));
+}
+
+void test_display_device_first_commit_writes_every_digit(void) {
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_PTR(&leftBackend, backend_write_fake.arg0_val);
+    TEST_ASSERT_EQUAL_UINT8(0, backend_write_fake.arg2_val);
+    TEST_ASSERT_EQUAL_UINT8(NUM_DIGITS, backend_write_fake.arg3_val);
+}
+
+void test_display_device_first_commit_sends_state(void) {
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_set_brightness_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(DISPLAY_MAX_BRIGHTNESS, backend_set_brightness_fake.arg1_val);
+    TEST_ASSERT_EQUAL(1, backend_set_power_fake.call_count);
+    TEST_ASSERT_TRUE(backend_set_power_fake.arg1_val);
+}
+
+void test_display_device_unchanged_commit_writes_nothing(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    commit_left();
+
+    TEST_ASSERT_EQUAL(0, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL(0, backend_set_brightness_fake.call_count);
+    TEST_ASSERT_EQUAL(0, backend_set_power_fake.call_count);
+    TEST_ASSERT_EQUAL(1, backend_flush_fake.call_count);
+}
+
+void test_display_device_one_changed_digit_writes_one_digit(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    display_device_back_buffer(&left)->segments[3] = HexTo7Seg[9];
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(3, backend_write_fake.arg2_val);
+    TEST_ASSERT_EQUAL_UINT8(1, backend_write_fake.arg3_val);
+}
+
+void test_display_device_changed_digits_write_span_between_them(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    display_device_back_buffer(&left)->segments[1] = HexTo7Seg[9];
+    display_device_back_buffer(&left)->segments[4] = HexTo7Seg[9];
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(1, backend_write_fake.arg2_val);
+    TEST_ASSERT_EQUAL_UINT8(4, backend_write_fake.arg3_val);
+}
+
+void test_display_device_failed_write_is_resent(void) {
+    show_left_digits();
+    clear_fake_history();
+    backend_write_fake.custom_fake = NULL;
+    backend_write_fake.return_val = 1;
+
+    display_device_back_buffer(&left)->segments[5] = HexTo7Seg[9];
+    TEST_ASSERT_EQUAL(1, commit_left());
+
+    backend_write_fake.return_val = 0;
+    commit_left();
+
+    TEST_ASSERT_EQUAL(2, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(5, backend_write_fake.arg2_history[1]);
+    TEST_ASSERT_EQUAL_UINT8(1, backend_write_fake.arg3_history[1]);
+}
+
+void test_display_device_brightness_sent_only_when_changed(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    display_device_set_brightness(&left, 3);
+    commit_left();
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_set_brightness_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(3, backend_set_brightness_fake.arg1_val);
+}
+
+void test_display_device_brightness_is_limited(void) {
+    display_device_set_brightness(&left, DISPLAY_MAX_BRIGHTNESS + 1);
+    commit_left();
+
+    TEST_ASSERT_EQUAL_UINT8(DISPLAY_MAX_BRIGHTNESS, backend_set_brightness_fake.arg1_val);
+}
+
+void test_display_device_same_backend_type_flushed_together(void) {
+    display_device_commit(displays, 2);
+
+    TEST_ASSERT_EQUAL(1, backend_flush_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(2, backend_flush_fake.arg1_val);
+}
+
+void test_display_device_backend_types_flushed_separately(void) {
+    display_device_init(&right, &otherOps, &rightBackend, NUM_DIGITS);
+
+    display_device_commit(displays, 2);
+
+    TEST_ASSERT_EQUAL(2, backend_flush_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(1, backend_flush_fake.arg1_history[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, backend_flush_fake.arg1_history[1]);
+}
+
+void test_display_device_commit_rejects_too_many_displays(void) {
+    TEST_ASSERT_EQUAL(1, display_device_commit(displays, DISPLAY_MAX_GROUP + 1));
+}
+
+void test_display_device_tick_without_effect_is_unchanged(void) {
+    TEST_ASSERT_FALSE(display_device_tick(displays, 2, 0));
+    TEST_ASSERT_FALSE(display_device_tick(displays, 2, 1000));
+}
+
+void test_display_device_tick_after_set_effect_is_changed_once(void) {
+    display_device_set_effect(&left, DISPLAY_EFFECT_BLINK, 0x3F);
+
+    TEST_ASSERT_TRUE(display_device_tick(displays, 2, 0));
+    TEST_ASSERT_FALSE(display_device_tick(displays, 2, 1));
+}
+
+void test_display_device_blink_changes_each_half_period(void) {
+    display_device_set_effect(&left, DISPLAY_EFFECT_BLINK, 0x3F);
+    display_device_tick(displays, 2, 0);
+
+    TEST_ASSERT_FALSE(display_device_tick(displays, 2, (1 << DISPLAY_BLINK_SHIFT) - 1));
+    TEST_ASSERT_TRUE(display_device_tick(displays, 2, 1 << DISPLAY_BLINK_SHIFT));
+    TEST_ASSERT_FALSE(display_device_tick(displays, 2, (2 << DISPLAY_BLINK_SHIFT) - 1));
+    TEST_ASSERT_TRUE(display_device_tick(displays, 2, 2 << DISPLAY_BLINK_SHIFT));
+}
+
+void test_display_device_blink_off_phase_blanks_mask_digits(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    display_device_set_effect(&left, DISPLAY_EFFECT_BLINK, 0x0C);
+    display_device_tick(displays, 1, 1 << DISPLAY_BLINK_SHIFT);
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_UINT8(2, backend_write_fake.arg2_val);
+    TEST_ASSERT_EQUAL_UINT8(2, backend_write_fake.arg3_val);
+    TEST_ASSERT_EQUAL_HEX8(HexTo7Seg[1], writtenSegments[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x0, writtenSegments[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x0, writtenSegments[3]);
+    TEST_ASSERT_EQUAL_HEX8(HexTo7Seg[4], writtenSegments[4]);
+}
+
+void test_display_device_blink_on_phase_restores_digits(void) {
+    show_left_digits();
+    display_device_set_effect(&left, DISPLAY_EFFECT_BLINK, 0x0C);
+    display_device_tick(displays, 1, 1 << DISPLAY_BLINK_SHIFT);
+    commit_left();
+    clear_fake_history();
+
+    display_device_tick(displays, 1, 2 << DISPLAY_BLINK_SHIFT);
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_write_fake.call_count);
+    TEST_ASSERT_EQUAL_HEX8(HexTo7Seg[2], writtenSegments[2]);
+    TEST_ASSERT_EQUAL_HEX8(HexTo7Seg[3], writtenSegments[3]);
+}
+
+void test_display_device_flash_turns_power_off_each_half_period(void) {
+    show_left_digits();
+    clear_fake_history();
+
+    display_device_set_effect(&left, DISPLAY_EFFECT_FLASH, 0);
+    display_device_tick(displays, 1, 1 << DISPLAY_FLASH_SHIFT);
+    commit_left();
+
+    TEST_ASSERT_EQUAL(1, backend_set_power_fake.call_count);
+    TEST_ASSERT_FALSE(backend_set_power_fake.arg1_val);
+    TEST_ASSERT_EQUAL(0, backend_write_fake.call_count);
+
+    TEST_ASSERT_TRUE(display_device_tick(displays, 1, 2 << DISPLAY_FLASH_SHIFT));
+    commit_left();
+
+    TEST_ASSERT_EQUAL(2, backend_set_power_fake.call_count);
+    TEST_ASSERT_TRUE(backend_set_power_fake.arg1_val);
+}
+
+void test_display_device_flash_keeps_power_off_display_off(void) {
+    show_left_digits();
+    display_device_set_power(&left, false);
+    display_device_set_effect(&left, DISPLAY_EFFECT_FLASH, 0);
+    display_device_tick(displays, 1, 0);
+    commit_left();
+
+    TEST_ASSERT_FALSE(backend_set_power_fake.arg1_val);
+}
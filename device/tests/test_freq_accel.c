@@ -0,0 +1,155 @@
+/**
+ * @file test_freq_accel.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-22
+ * @brief Tests for the encoder acceleration curves
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unity.h"
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+#define FFF_MOCK_IMPL
+
+#include "avr_extends/uptime.h"
+#include "freq_input.h"
+
+#include "freq_accel.h"
+
+FAKE_VALUE_FUNC(uint64_t, uptime_ms);
+
+/**
+ * @brief Pass a detent to freq_accel as freq_input_snapshot would, the
+ * detent is read at the same uptime it was turned
+ * @param time the time of the detent in ms
+ * @param flags the FREQ_EVENT flags of the detent
+ *
+ */
+static void detent(uint64_t time, uint8_t flags) {
+    struct FreqInputEvent event = { .flags = flags, .time = (uint16_t)time };
+    uptime_ms_fake.return_val = time;
+
+    freq_accel_add_event(&event);
+}
+
+/**
+ * @brief Turn the fine encoder up twice and read the second detent
+ * @param interval the ms between the detents
+ *
+ * @return the scaled detents of the second detent
+ */
+static int8_t fine_pair(uint16_t interval) {
+    detent(1000, 0);
+    freq_accel_get(FREQ_FINE_INPUT);
+
+    detent(1000 + interval, 0);
+    return freq_accel_get(FREQ_FINE_INPUT);
+}
+
+/**
+ * @brief Turn the coarse encoder up twice and read the second detent
+ * @param interval the ms between the detents
+ *
+ * @return the scaled detents of the second detent
+ */
+static int8_t coarse_pair(uint16_t interval) {
+    detent(1000, FREQ_EVENT_COARSE);
+    freq_accel_get(FREQ_COURSE_INPUT);
+
+    detent(1000 + interval, FREQ_EVENT_COARSE);
+    return freq_accel_get(FREQ_COURSE_INPUT);
+}
+
+void setUp(void) {
+    RESET_FAKE(uptime_ms);
+    FFF_RESET_HISTORY();
+
+    freq_accel_clear();
+}
+
+void tearDown(void) {
+
+}
+
+// =========================== Tests ===========================
+void test_freq_accel_first_detent_counts_once(void) {
+    detent(1000, 0);
+
+    TEST_ASSERT_EQUAL_INT8(1, freq_accel_get(FREQ_FINE_INPUT));
+}
+
+void test_freq_accel_fine_curve_steps(void) {
+    TEST_ASSERT_EQUAL_INT8(10, fine_pair(25));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(5, fine_pair(26));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(5, fine_pair(50));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(2, fine_pair(90));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(1, fine_pair(91));
+}
+
+void test_freq_accel_coarse_curve_steps(void) {
+    TEST_ASSERT_EQUAL_INT8(4, coarse_pair(40));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(2, coarse_pair(80));
+    freq_accel_clear();
+    TEST_ASSERT_EQUAL_INT8(1, coarse_pair(81));
+}
+
+void test_freq_accel_decrement_is_negative(void) {
+    detent(1000, FREQ_EVENT_DECREMENT);
+    detent(1020, FREQ_EVENT_DECREMENT);
+
+    TEST_ASSERT_EQUAL_INT8(-11, freq_accel_get(FREQ_FINE_INPUT));
+}
+
+void test_freq_accel_direction_change_is_not_accelerated(void) {
+    detent(1000, 0);
+    detent(1020, FREQ_EVENT_DECREMENT);
+
+    TEST_ASSERT_EQUAL_INT8(0, freq_accel_get(FREQ_FINE_INPUT));
+}
+
+void test_freq_accel_encoders_are_separate(void) {
+    detent(1000, 0);
+    detent(1010, FREQ_EVENT_COARSE);
+    detent(1020, 0);
+
+    TEST_ASSERT_EQUAL_INT8(11, freq_accel_get(FREQ_FINE_INPUT));
+    TEST_ASSERT_EQUAL_INT8(1, freq_accel_get(FREQ_COURSE_INPUT));
+}
+
+void test_freq_accel_detent_time_wrap_is_not_accelerated(void) {
+    detent(1000, 0);
+    freq_accel_get(FREQ_FINE_INPUT);
+
+    // 65.536 s later the 16 bit detent time is only 10 ms on
+    detent(1000 + 65536 + 10, 0);
+
+    TEST_ASSERT_EQUAL_INT8(1, freq_accel_get(FREQ_FINE_INPUT));
+}
+
+void test_freq_accel_clear_stops_acceleration(void) {
+    detent(1000, 0);
+    freq_accel_clear();
+    detent(1020, 0);
+
+    TEST_ASSERT_EQUAL_INT8(1, freq_accel_get(FREQ_FINE_INPUT));
+}
+
+void test_freq_accel_get_limits_to_int8(void) {
+    detent(1000, 0);
+    for (uint8_t i = 1; i <= 20; i++) {
+        detent(1000 + i * 10, 0);
+    }
+
+    // 1 + 20 * 10 detents, the rest is kept for the next read
+    TEST_ASSERT_EQUAL_INT8(INT8_MAX, freq_accel_get(FREQ_FINE_INPUT));
+    TEST_ASSERT_EQUAL_INT8(201 - INT8_MAX, freq_accel_get(FREQ_FINE_INPUT));
+}
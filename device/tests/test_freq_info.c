@@ -0,0 +1,299 @@
+/**
+ * @file test_freq_info.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-03-01
+ * @brief Tests for the frequency storage module
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "unity.h"
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+#define FFF_MOCK_IMPL
+
+#include "avr_extends/uptime.h"
+#include "freq_input.h"
+#include "freq_accel.h"
+
+#include "freq_info.h"
+
+FAKE_VALUE_FUNC(uint64_t, uptime_ms);
+FAKE_VALUE_FUNC(int, freq_input_init);
+FAKE_VOID_FUNC(freq_input_clear_detents);
+FAKE_VALUE_FUNC(int8_t, freq_accel_get, FreqInputSources_t);
+FAKE_VOID_FUNC(freq_accel_clear);
+
+static int8_t fineDetents;
+static int8_t coarseDetents;
+
+static int8_t freq_accel_get_detents(FreqInputSources_t input) {
+    return (input == FREQ_FINE_INPUT) ? fineDetents : coarseDetents;
+}
+
+/**
+ * @brief Turn the encoders of a radio as if freq_accel passed the detents
+ * straight through
+ * @param freqType the radio to turn
+ * @param fine the fine detents
+ * @param coarse the coarse detents
+ *
+ */
+static void turn(freqType_t freqType, int8_t fine, int8_t coarse) {
+    struct FreqInputSnapshot input = { .fine = fine, .coarse = coarse };
+    fineDetents = fine;
+    coarseDetents = coarse;
+
+    freq_info_update(freqType, &input);
+}
+
+void setUp(void) {
+    RESET_FAKE(uptime_ms);
+    RESET_FAKE(freq_input_init);
+    RESET_FAKE(freq_input_clear_detents);
+    RESET_FAKE(freq_accel_get);
+    RESET_FAKE(freq_accel_clear);
+    FFF_RESET_HISTORY();
+
+    freq_accel_get_fake.custom_fake = freq_accel_get_detents;
+    uptime_ms_fake.return_val = 1000;
+}
+
+void tearDown(void) {
+
+}
+
+// =========================== Tests ===========================
+void test_freq_info_update_com_wraps_past_maximum(void) {
+    freq_info_set(COM1, STANDBY_FREQ, 137995);
+
+    turn(COM1, 1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(108000, freq_info_get(COM1, STANDBY_FREQ));
+}
+
+void test_freq_info_update_com_wraps_past_minimum(void) {
+    freq_info_set(COM1, STANDBY_FREQ, 108000);
+
+    turn(COM1, -1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(137995, freq_info_get(COM1, STANDBY_FREQ));
+}
+
+void test_freq_info_update_com_coarse_moves_one_mhz(void) {
+    freq_info_set(COM2, STANDBY_FREQ, 118000);
+
+    turn(COM2, 2, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(119010, freq_info_get(COM2, STANDBY_FREQ));
+}
+
+void test_freq_info_update_nav_coarse_wraps(void) {
+    freq_info_set(NAV1, STANDBY_FREQ, 117950);
+
+    turn(NAV1, 0, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(108950, freq_info_get(NAV1, STANDBY_FREQ));
+}
+
+void test_freq_info_update_wraps_adjust_larger_than_range(void) {
+    freq_info_set(COM1, STANDBY_FREQ, 118000);
+
+    turn(COM1, 127, 127);
+
+    // 127MHz and 635kHz up, wrapped four times around the 30MHz range
+    TEST_ASSERT_EQUAL_UINT32(125635, freq_info_get(COM1, STANDBY_FREQ));
+}
+
+void test_freq_info_update_wraps_negative_adjust_larger_than_range(void) {
+    freq_info_set(COM1, STANDBY_FREQ, 118000);
+
+    turn(COM1, -128, -128);
+
+    TEST_ASSERT_EQUAL_UINT32(109360, freq_info_get(COM1, STANDBY_FREQ));
+}
+
+void test_freq_info_update_leaves_active_unchanged(void) {
+    freq_info_set(COM1, ACTIVE_FREQ, 121500);
+    freq_info_set(COM1, STANDBY_FREQ, 118000);
+
+    turn(COM1, 3, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(121500, freq_info_get(COM1, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_no_detents_is_unchanged(void) {
+    freq_info_set(NAV2, STANDBY_FREQ, 110500);
+    uint8_t version = freq_info_get_version();
+
+    turn(NAV2, 0, 0);
+
+    TEST_ASSERT_EQUAL_UINT8(version, freq_info_get_version());
+    TEST_ASSERT_EQUAL_UINT32(110500, freq_info_get(NAV2, STANDBY_FREQ));
+}
+
+void test_freq_info_set_rounds_down_to_nearest_channel(void) {
+    freq_info_set(COM1, ACTIVE_FREQ, 118002);
+
+    TEST_ASSERT_EQUAL_UINT32(118000, freq_info_get(COM1, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_rounds_up_to_nearest_channel(void) {
+    freq_info_set(COM1, ACTIVE_FREQ, 118003);
+
+    TEST_ASSERT_EQUAL_UINT32(118005, freq_info_get(COM1, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_rounds_halfway_nav_up(void) {
+    freq_info_set(NAV1, ACTIVE_FREQ, 108024);
+    TEST_ASSERT_EQUAL_UINT32(108000, freq_info_get(NAV1, ACTIVE_FREQ));
+
+    freq_info_set(NAV1, ACTIVE_FREQ, 108025);
+    TEST_ASSERT_EQUAL_UINT32(108050, freq_info_get(NAV1, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_clamps_below_minimum(void) {
+    freq_info_set(COM1, ACTIVE_FREQ, 100000);
+
+    TEST_ASSERT_EQUAL_UINT32(108000, freq_info_get(COM1, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_clamps_above_maximum(void) {
+    freq_info_set(NAV2, ACTIVE_FREQ, 136000);
+
+    TEST_ASSERT_EQUAL_UINT32(117950, freq_info_get(NAV2, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_clamps_rounding_past_maximum(void) {
+    freq_info_set(COM2, ACTIVE_FREQ, 137998);
+
+    TEST_ASSERT_EQUAL_UINT32(137995, freq_info_get(COM2, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_clears_detents(void) {
+    freq_info_set(COM1, ACTIVE_FREQ, 118000);
+
+    TEST_ASSERT_EQUAL(1, freq_input_clear_detents_fake.call_count);
+    TEST_ASSERT_EQUAL(1, freq_accel_clear_fake.call_count);
+}
+
+void test_freq_info_set_dme_reads_back(void) {
+    freq_info_set(DME, ACTIVE_FREQ, 113500);
+    freq_info_set(DME, STANDBY_FREQ, 108050);
+
+    TEST_ASSERT_EQUAL_UINT32(113500, freq_info_get(DME, ACTIVE_FREQ));
+    TEST_ASSERT_EQUAL_UINT32(108050, freq_info_get(DME, STANDBY_FREQ));
+}
+
+void test_freq_info_set_adf_reads_back(void) {
+    freq_info_set(ADF, ACTIVE_FREQ, 1799);
+    freq_info_set(ADF, STANDBY_FREQ, 190);
+
+    TEST_ASSERT_EQUAL_UINT32(1799, freq_info_get(ADF, ACTIVE_FREQ));
+    TEST_ASSERT_EQUAL_UINT32(190, freq_info_get(ADF, STANDBY_FREQ));
+}
+
+void test_freq_info_update_adf_coarse_moves_100_khz(void) {
+    freq_info_set(ADF, STANDBY_FREQ, 350);
+
+    turn(ADF, 0, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(450, freq_info_get(ADF, STANDBY_FREQ));
+}
+
+void test_freq_info_update_adf_wraps_past_maximum(void) {
+    freq_info_set(ADF, STANDBY_FREQ, 1799);
+
+    turn(ADF, 1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(190, freq_info_get(ADF, STANDBY_FREQ));
+}
+
+void test_freq_info_update_squawk_fine_carries(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 777);
+
+    turn(XPDR, 1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(1000, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_squawk_fine_borrows(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 1000);
+
+    turn(XPDR, -1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(777, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_squawk_wraps_past_7777(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 7777);
+
+    turn(XPDR, 1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(0, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_squawk_wraps_below_0000(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 0);
+
+    turn(XPDR, -1, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(7777, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_squawk_coarse_carries_into_first_digit(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 1700);
+
+    turn(XPDR, 0, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(2000, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_update_squawk_is_not_accelerated(void) {
+    struct FreqInputSnapshot input = { .fine = 1, .coarse = 0 };
+    fineDetents = 10;
+    freq_info_set(XPDR, ACTIVE_FREQ, 7000);
+
+    freq_info_update(XPDR, &input);
+
+    TEST_ASSERT_EQUAL_UINT32(7001, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_set_squawk_limits_digits_to_octal(void) {
+    freq_info_set(XPDR, ACTIVE_FREQ, 7899);
+
+    TEST_ASSERT_EQUAL_UINT32(7777, freq_info_get(XPDR, ACTIVE_FREQ));
+}
+
+void test_freq_info_swap_on_xpdr_starts_ident(void) {
+    struct FreqInputSnapshot input = { .fineGestures = 1 << FREQ_GESTURE_PRESS };
+    uptime_ms_fake.return_val = 5000;
+
+    TEST_ASSERT_TRUE(freq_info_check_swap(XPDR, &input));
+
+    TEST_ASSERT_TRUE(freq_info_get_ident());
+}
+
+void test_freq_info_ident_ends_after_18_s(void) {
+    struct FreqInputSnapshot input = { .fineGestures = 1 << FREQ_GESTURE_PRESS };
+    uptime_ms_fake.return_val = 5000;
+    freq_info_check_swap(XPDR, &input);
+
+    uptime_ms_fake.return_val = 5000 + 17999;
+    TEST_ASSERT_TRUE(freq_info_get_ident());
+
+    uptime_ms_fake.return_val = 5000 + 18000;
+    TEST_ASSERT_FALSE(freq_info_get_ident());
+}
+
+void test_freq_info_swap_on_com_does_not_start_ident(void) {
+    struct FreqInputSnapshot input = { .fineGestures = 1 << FREQ_GESTURE_PRESS };
+    uptime_ms_fake.return_val = 100000;
+
+    freq_info_check_swap(COM1, &input);
+
+    TEST_ASSERT_FALSE(freq_info_get_ident());
+}
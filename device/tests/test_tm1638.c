@@ -0,0 +1,354 @@
+/**
+ * @file test_tm1638.c
+ * @author Jack Duignan (JackpDuignan@gmail.com)
+ * @date 2025-04-12
+ * @brief Tests for the TM1638 driver, built with the GPIO transport so the
+ * bytes clocked out can be read back from the faked GPIO calls
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "fff.h"
+DEFINE_FFF_GLOBALS;
+#define FFF_MOCK_IMPL
+
+#include <avr/io.h>
+
+#include "avr_extends/GPIO.h"
+#include "avr_extends/delay.h"
+#include "avr_extends/uptime.h"
+
+#include "pin.h"
+
+#include "TM1638.h"
+
+#define INIT_STEP_MS 200 // Time between the start up display commands
+#define MAX_TRANSACTIONS 16
+#define MAX_TRANSACTION_BYTES (TM1638_RAM_SIZE + 1)
+
+#define DATA_AUTO_ADDRESS 0x40
+#define DATA_FIXED_ADDRESS 0x44
+#define ADDRESS(address) (0xC0 | (address))
+
+FAKE_VALUE_FUNC(uint64_t, uptime_ms);
+FAKE_VOID_FUNC(delay_us, uint32_t);
+FAKE_VOID_FUNC(GPIO_pin_init, pin_t, pinMode_t);
+FAKE_VOID_FUNC(GPIO_set_output, pin_t, bool);
+FAKE_VALUE_FUNC(bool, GPIO_get_state, pin_t);
+
+void TIMER2_COMPA_vect(void);
+
+/// @brief The bytes clocked out while one stb pin was low
+struct Transaction {
+    uint8_t stbPinNum;
+    uint8_t bytes[MAX_TRANSACTION_BYTES];
+    uint8_t len;
+};
+
+static struct Transaction transactions[MAX_TRANSACTIONS];
+static uint8_t numTransactions;
+
+// The bus as seen by the GPIO fake
+static bool clockHigh;
+static bool dataHigh;
+static bool selected; // True while an stb pin is low
+static uint8_t shift;
+static uint8_t bits;
+
+static struct TM1638Device left;
+static struct TM1638Device right;
+
+/**
+ * @brief Decode the GPIO transport from its pin writes, bits are read lsb
+ * first on the rising clock edge while an stb pin is low
+ * @param pin the pin written
+ * @param state the level written
+ *
+ */
+static void decode_set_output(pin_t pin, bool state) {
+    if (pin.num == DISP_CLK_PIN_NUM) {
+        if (selected && state && !clockHigh) {
+            shift |= (dataHigh ? 1 : 0) << bits;
+            if (++bits == 8) {
+                struct Transaction* transaction = &transactions[numTransactions];
+                transaction->bytes[transaction->len++] = shift;
+                shift = 0;
+                bits = 0;
+            }
+        }
+        clockHigh = state;
+    } else if (pin.num == DISP_DATA_PIN_NUM) {
+        dataHigh = state;
+    } else if (!state && !selected) {
+        selected = true;
+        transactions[numTransactions].stbPinNum = pin.num;
+        transactions[numTransactions].len = 0;
+    } else if (state && selected) {
+        selected = false;
+        numTransactions++;
+    }
+}
+
+/**
+ * @brief Run the transfer timer interrupt until the queue is empty
+ *
+ */
+static void run_transfers(void) {
+    while (TIMSK2 & (1 << OCIE2A)) {
+        TIMER2_COMPA_vect();
+    }
+}
+
+/**
+ * @brief Forget every transaction seen so far
+ *
+ */
+static void clear_transactions(void) {
+    memset(transactions, 0, sizeof(transactions));
+    numTransactions = 0;
+}
+
+/**
+ * @brief Initialise a device and run its start up to the end
+ * @param device the device
+ * @param stbPinNum the stb pin of the device
+ *
+ */
+static void bring_up(struct TM1638Device* device, uint8_t stbPinNum) {
+    tm1638_init(device, stbPinNum, DISP_DATA, DISP_CLK);
+
+    while (!tm1638_init_update(device)) {
+        run_transfers();
+        uptime_ms_fake.return_val += INIT_STEP_MS;
+    }
+    run_transfers();
+}
+
+/**
+ * @brief Write the digits 0-5 to a device so its shadow RAM is valid
+ * @param device the device
+ *
+ */
+static void show_digits(struct TM1638Device* device) {
+    uint8_t segments[TM1638_DIGITS];
+    for (uint8_t i = 0; i < TM1638_DIGITS; i++) {
+        segments[i] = HexTo7Seg[i];
+    }
+
+    tm1638_write_segments(device, 0, segments, TM1638_DIGITS);
+    run_transfers();
+}
+
+/**
+ * @brief Check a transaction
+ * @param index the transaction to check
+ * @param stbPinNum the stb pin it should select
+ * @param bytes the bytes it should hold
+ * @param len the length of bytes
+ *
+ */
+static void assert_transaction(uint8_t index, uint8_t stbPinNum, const uint8_t bytes[], uint8_t len) {
+    TEST_ASSERT_TRUE(index < numTransactions);
+    TEST_ASSERT_EQUAL_UINT8(stbPinNum, transactions[index].stbPinNum);
+    TEST_ASSERT_EQUAL_UINT8(len, transactions[index].len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(bytes, transactions[index].bytes, len);
+}
+
+void setUp(void) {
+    RESET_FAKE(uptime_ms);
+    RESET_FAKE(delay_us);
+    RESET_FAKE(GPIO_pin_init);
+    RESET_FAKE(GPIO_set_output);
+    RESET_FAKE(GPIO_get_state);
+    FFF_RESET_HISTORY();
+
+    GPIO_set_output_fake.custom_fake = decode_set_output;
+    uptime_ms_fake.return_val = 1000;
+    clockHigh = true;
+    dataHigh = true;
+    selected = false;
+    shift = 0;
+    bits = 0;
+
+    bring_up(&left, DISP_2_SELECT_PIN_NUM);
+    bring_up(&right, DISP_1_SELECT_PIN_NUM);
+    show_digits(&left);
+    show_digits(&right);
+    clear_transactions();
+}
+
+void tearDown(void) {
+
+}
+
+// =========================== Tests ===========================
+void test_tm1638_first_write_sends_all_of_ram(void) {
+    struct TM1638Device device;
+    bring_up(&device, DISP_2_SELECT_PIN_NUM);
+    clear_transactions();
+
+    show_digits(&device);
+
+    TEST_ASSERT_EQUAL_UINT8(2, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_AUTO_ADDRESS }, 1);
+    TEST_ASSERT_EQUAL_UINT8(TM1638_RAM_SIZE + 1, transactions[1].len);
+    TEST_ASSERT_EQUAL_HEX8(ADDRESS(0), transactions[1].bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(HexTo7Seg[5], transactions[1].bytes[1 + 5 * 2]);
+}
+
+void test_tm1638_unchanged_write_sends_nothing(void) {
+    show_digits(&left);
+
+    TEST_ASSERT_EQUAL_UINT8(0, numTransactions);
+}
+
+void test_tm1638_one_digit_uses_fixed_address(void) {
+    uint8_t segment = HexTo7Seg[9];
+
+    tm1638_write_segments(&left, 2, &segment, 1);
+    run_transfers();
+
+    TEST_ASSERT_EQUAL_UINT8(2, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(1, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(4), HexTo7Seg[9] }, 2);
+}
+
+void test_tm1638_fixed_address_mode_is_not_resent(void) {
+    uint8_t segment = HexTo7Seg[9];
+    tm1638_write_segments(&left, 2, &segment, 1);
+    run_transfers();
+    clear_transactions();
+
+    tm1638_write_segments(&left, 4, &segment, 1);
+    run_transfers();
+
+    TEST_ASSERT_EQUAL_UINT8(1, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(8), HexTo7Seg[9] }, 2);
+}
+
+void test_tm1638_neighbouring_digits_join_one_run(void) {
+    uint8_t segments[] = { HexTo7Seg[8], HexTo7Seg[9] };
+
+    tm1638_write_segments(&left, 1, segments, 2);
+    run_transfers();
+
+    // The unchanged byte between the digits is resent rather than costing
+    // a second address byte, and the device is still in auto address mode
+    TEST_ASSERT_EQUAL_UINT8(1, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM,
+        (const uint8_t[]){ ADDRESS(2), HexTo7Seg[8], 0x00, HexTo7Seg[9] }, 4);
+}
+
+void test_tm1638_distant_digits_are_separate_runs(void) {
+    uint8_t segments[] = { HexTo7Seg[9], HexTo7Seg[2], HexTo7Seg[9] };
+
+    tm1638_write_segments(&left, 1, segments, 3);
+    run_transfers();
+
+    TEST_ASSERT_EQUAL_UINT8(3, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(1, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(2), HexTo7Seg[9] }, 2);
+    assert_transaction(2, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(6), HexTo7Seg[9] }, 2);
+}
+
+void test_tm1638_runs_are_grouped_by_address_mode(void) {
+    uint8_t segments[] = { HexTo7Seg[9], HexTo7Seg[1], HexTo7Seg[2], HexTo7Seg[8], HexTo7Seg[9] };
+
+    tm1638_write_segments(&left, 0, segments, 5);
+    run_transfers();
+
+    // Fixed address runs go first so the data command is only sent twice
+    TEST_ASSERT_EQUAL_UINT8(4, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(1, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(0), HexTo7Seg[9] }, 2);
+    assert_transaction(2, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_AUTO_ADDRESS }, 1);
+    assert_transaction(3, DISP_2_SELECT_PIN_NUM,
+        (const uint8_t[]){ ADDRESS(6), HexTo7Seg[8], 0x00, HexTo7Seg[9] }, 4);
+}
+
+void test_tm1638_flush_sends_data_commands_before_runs(void) {
+    uint8_t segments[TM1638_DIGITS] = { HexTo7Seg[9] };
+    void* backends[] = { &left, &right };
+
+    tm1638DisplayOps.write(&left, segments, 0, 1);
+    tm1638DisplayOps.write(&right, segments, 0, 1);
+    TEST_ASSERT_EQUAL_UINT8(0, numTransactions);
+
+    tm1638DisplayOps.flush(backends, 2);
+    run_transfers();
+
+    TEST_ASSERT_EQUAL_UINT8(4, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(1, DISP_1_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(2, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(0), HexTo7Seg[9] }, 2);
+    assert_transaction(3, DISP_1_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(0), HexTo7Seg[9] }, 2);
+}
+
+void test_tm1638_flush_only_sends_needed_data_commands(void) {
+    uint8_t segments[TM1638_DIGITS] = { HexTo7Seg[9], 0, HexTo7Seg[8], HexTo7Seg[9] };
+    void* backends[] = { &left, &right };
+
+    tm1638DisplayOps.write(&left, segments, 0, 1);
+    tm1638DisplayOps.write(&right, segments, 2, 2);
+    tm1638DisplayOps.flush(backends, 2);
+    run_transfers();
+
+    // The right display is already in auto address mode
+    TEST_ASSERT_EQUAL_UINT8(3, numTransactions);
+    assert_transaction(0, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ DATA_FIXED_ADDRESS }, 1);
+    assert_transaction(1, DISP_2_SELECT_PIN_NUM, (const uint8_t[]){ ADDRESS(0), HexTo7Seg[9] }, 2);
+    assert_transaction(2, DISP_1_SELECT_PIN_NUM,
+        (const uint8_t[]){ ADDRESS(4), HexTo7Seg[8], 0x00, HexTo7Seg[9] }, 4);
+}
+
+void test_tm1638_write_segments_rejects_out_of_range(void) {
+    uint8_t segments[2] = { 0 };
+
+    TEST_ASSERT_EQUAL(1, tm1638_write_segments(&left, TM1638_NUM_GRIDS - 1, segments, 2));
+}
+
+/**
+ * @brief Check tm1638_format_decimal against the expected digits
+ * @param value the value to format
+ * @param leadingZeros passed on to tm1638_format_decimal
+ * @param digits the expected digits msd first, ' ' for a blank digit
+ *
+ */
+static void assert_decimal(uint32_t value, bool leadingZeros, const char digits[]) {
+    uint8_t expected[TM1638_DIGITS];
+    uint8_t segments[TM1638_DIGITS];
+
+    for (uint8_t i = 0; i < TM1638_DIGITS; i++) {
+        expected[i] = digits[i] == ' ' ? 0x00 : HexTo7Seg[digits[i] - '0'];
+    }
+
+    tm1638_format_decimal(value, segments, leadingZeros);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, segments, TM1638_DIGITS);
+}
+
+void test_tm1638_format_decimal_all_digits(void) {
+    assert_decimal(137975, false, "137975");
+}
+
+void test_tm1638_format_decimal_blanks_leading_zeros(void) {
+    assert_decimal(190, false, "   190");
+}
+
+void test_tm1638_format_decimal_shows_leading_zeros(void) {
+    assert_decimal(190, true, "000190");
+}
+
+void test_tm1638_format_decimal_zero_keeps_last_digit(void) {
+    assert_decimal(0, false, "     0");
+    assert_decimal(0, true, "000000");
+}
+
+void test_tm1638_format_decimal_drops_high_digits(void) {
+    assert_decimal(1234567, false, "234567");
+    assert_decimal(UINT32_MAX, false, "967295");
+}